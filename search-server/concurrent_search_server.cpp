@@ -0,0 +1,102 @@
+#include "concurrent_search_server.h"
+
+#include <functional>
+#include <thread>
+
+namespace {
+
+size_t GetReaderSlot() {
+    static thread_local const size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    return slot;
+}
+
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(std::string_view stop_words_text)
+    : ConcurrentSearchServer(SplitIntoWords(stop_words_text)) {
+}
+
+ConcurrentSearchServer::ReadGuard::ReadGuard(const SearchServer* server, std::atomic<int>* reader_count)
+    : server_(server)
+    , reader_count_(reader_count) {
+}
+
+ConcurrentSearchServer::ReadGuard::ReadGuard(ReadGuard&& other) noexcept
+    : server_(other.server_)
+    , reader_count_(other.reader_count_) {
+    other.reader_count_ = nullptr;
+}
+
+ConcurrentSearchServer::ReadGuard::~ReadGuard() {
+    if (reader_count_ != nullptr) {
+        reader_count_->fetch_sub(1, std::memory_order_release);
+    }
+}
+
+const SearchServer& ConcurrentSearchServer::ReadGuard::operator*() const {
+    return *server_;
+}
+
+const SearchServer* ConcurrentSearchServer::ReadGuard::operator->() const {
+    return server_;
+}
+
+//Читатель сначала отмечается на копии, потом проверяет, что она всё ещё активна. Писатель сначала переключает
+//активную копию, потом проверяет счётчики. Оба шага последовательно согласованы, поэтому либо писатель видит
+//читателя и ждёт его, либо читатель видит переключение и уходит на другую копию
+ConcurrentSearchServer::ReadGuard ConcurrentSearchServer::Read() const {
+    const size_t slot = GetReaderSlot() % READER_SLOT_COUNT;
+    while (true) {
+        const int active = active_.load();
+        std::atomic<int>& reader_count = replicas_[active].readers[slot].count;
+        reader_count.fetch_add(1);
+        if (active_.load() == active) {
+            return ReadGuard(replicas_[active].server.get(), &reader_count);
+        }
+        reader_count.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Write([&](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    Write([&documents](SearchServer& server) {
+        server.AddDocuments(documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    Write([&document_ids](SearchServer& server) {
+        server.RemoveDocuments(document_ids);
+    });
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, int top_count) const {
+    return Read()->FindTopDocuments(raw_query, top_count);
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, int top_count) const {
+    return Read()->FindTopDocuments(raw_query, status, top_count);
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::WaitForReaders(const Replica& replica) const {
+    for (const ReaderSlot& slot : replica.readers) {
+        while (slot.count.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+//Поисковый сервер, который можно читать во время изменений. Индекс хранится в двух копиях: читатели работают
+//с активной, писатель применяет изменение к неактивной, делает её активной, дожидается ухода читателей
+//со старой копии и повторяет изменение на ней. Читатель не блокируется писателем и не видит изменение наполовину,
+//писатели выполняются по одному. Цена - двойная память индекса и двойная работа при записи
+class ConcurrentSearchServer {
+public:
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words);
+    explicit ConcurrentSearchServer(std::string_view stop_words_text);
+
+    //Закрепляет текущую версию индекса: пока объект жив, она не меняется, и string_view из её
+    //MatchDocument и GetWordFrequencies остаются валидными. Писатели ждут, пока закреплённую версию отпустят,
+    //поэтому поток, удерживающий ReadGuard, не должен сам менять сервер
+    class ReadGuard {
+    public:
+        ReadGuard(ReadGuard&& other) noexcept;
+        ReadGuard& operator=(ReadGuard&&) = delete;
+        ~ReadGuard();
+
+        const SearchServer& operator*() const;
+        const SearchServer* operator->() const;
+
+    private:
+        friend class ConcurrentSearchServer;
+
+        ReadGuard(const SearchServer* server, std::atomic<int>* reader_count);
+
+        const SearchServer* server_;
+        std::atomic<int>* reader_count_;
+    };
+    ReadGuard Read() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    //Результат не ссылается на индекс, поэтому версия закрепляется только на время запроса
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    int GetDocumentCount() const;
+
+private:
+    //Счётчики читателей разнесены по кеш-линиям, чтобы читатели из разных потоков не делили одну линию
+    static constexpr size_t READER_SLOT_COUNT = 32;
+    struct alignas(64) ReaderSlot {
+        std::atomic<int> count = 0;
+    };
+    struct Replica {
+        std::unique_ptr<SearchServer> server;
+        mutable std::array<ReaderSlot, READER_SLOT_COUNT> readers;
+    };
+
+    std::array<Replica, 2> replicas_;
+    std::atomic<int> active_ = 0;
+    std::mutex write_mutex_;
+
+    //Применяет изменение к обеим копиям. Если изменение бросило исключение на первой копии, ничего не меняется.
+    //Исключение на второй копии (нехватка памяти при пакетном добавлении или уплотнении) означает, что копии
+    //разошлись, и читатели видели бы разные индексы в зависимости от активной копии. SearchServer не копируется,
+    //восстановить вторую копию из первой нечем, поэтому такой сбой завершает процесс через std::terminate
+    template <typename Update>
+    void Write(Update update);
+    void WaitForReaders(const Replica& replica) const;
+};
+
+template <typename StringContainer>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringContainer& stop_words) {
+    for (Replica& replica : replicas_) {
+        replica.server = std::make_unique<SearchServer>(stop_words);
+    }
+}
+
+template <typename Update>
+void ConcurrentSearchServer::Write(Update update) {
+    std::lock_guard lock(write_mutex_);
+    const int active = active_.load();
+    Replica& standby = replicas_[1 - active];
+    //Читатели, закрепившие копию до предыдущего переключения, могли ещё не уйти
+    WaitForReaders(standby);
+    update(*standby.server);
+    active_.store(1 - active);
+    WaitForReaders(replicas_[active]);
+    try {
+        update(*replicas_[active].server);
+    } catch (...) {
+        std::terminate();
+    }
+}
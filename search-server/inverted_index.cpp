@@ -0,0 +1,499 @@
+#include "inverted_index.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int LANE_COUNT = 4;
+constexpr int LANE_LENGTH = PostingList::BLOCK_SIZE / LANE_COUNT;
+constexpr double TERM_FREQ_SCALE = 65535.0;
+
+int GetBitWidth(uint32_t value) {
+    int bit_width = 0;
+    while (value > 0) {
+        ++bit_width;
+        value >>= 1;
+    }
+    return bit_width;
+}
+
+//Значение i блока лежит в полосе i % 4 на месте i / 4. Полоса из 32 значений по bit_width бит занимает
+//bit_width слов, слово j полосы l - packed[j * 4 + l], так что одно 128-битное чтение даёт слово всех полос
+void PackBlock(const uint32_t* values, int bit_width, uint32_t* packed) {
+    if (bit_width == 32) {
+        std::copy(values, values + PostingList::BLOCK_SIZE, packed);
+        return;
+    }
+    for (int lane = 0; lane < LANE_COUNT; ++lane) {
+        uint32_t* word = packed + lane;
+        int bit_pos = 0;
+        *word = 0;
+        for (int i = 0; i < LANE_LENGTH; ++i) {
+            const uint32_t value = values[i * LANE_COUNT + lane];
+            *word |= value << bit_pos;
+            bit_pos += bit_width;
+            if (bit_pos >= 32 && i + 1 < LANE_LENGTH) {
+                bit_pos -= 32;
+                word += LANE_COUNT;
+                *word = bit_pos > 0 ? value >> (bit_width - bit_pos) : 0;
+            }
+        }
+    }
+}
+
+void UnpackBlock(const uint32_t* packed, int bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        std::fill(values, values + PostingList::BLOCK_SIZE, 0);
+        return;
+    }
+    if (bit_width == 32) {
+        std::copy(packed, packed + PostingList::BLOCK_SIZE, values);
+        return;
+    }
+    const uint32_t mask = (1u << bit_width) - 1;
+    int bit_pos = 0;
+#ifdef __SSE2__
+    const __m128i lane_mask = _mm_set1_epi32(static_cast<int>(mask));
+    const __m128i* word = reinterpret_cast<const __m128i*>(packed);
+    __m128i current = _mm_loadu_si128(word);
+    for (int i = 0; i < LANE_LENGTH; ++i) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(bit_pos));
+        bit_pos += bit_width;
+        if (bit_pos >= 32 && i + 1 < LANE_LENGTH) {
+            bit_pos -= 32;
+            current = _mm_loadu_si128(++word);
+            if (bit_pos > 0) {
+                value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(bit_width - bit_pos)));
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * LANE_COUNT), _mm_and_si128(value, lane_mask));
+    }
+#else
+    const uint32_t* word = packed;
+    for (int i = 0; i < LANE_LENGTH; ++i) {
+        uint32_t* lane_values = values + i * LANE_COUNT;
+        for (int lane = 0; lane < LANE_COUNT; ++lane) {
+            lane_values[lane] = word[lane] >> bit_pos;
+        }
+        bit_pos += bit_width;
+        if (bit_pos >= 32 && i + 1 < LANE_LENGTH) {
+            bit_pos -= 32;
+            word += LANE_COUNT;
+            if (bit_pos > 0) {
+                for (int lane = 0; lane < LANE_COUNT; ++lane) {
+                    lane_values[lane] |= word[lane] << (bit_width - bit_pos);
+                }
+            }
+        }
+        for (int lane = 0; lane < LANE_COUNT; ++lane) {
+            lane_values[lane] &= mask;
+        }
+    }
+#endif
+}
+
+}
+
+size_t PostingList::size() const {
+    return term_freqs_.size();
+}
+
+bool PostingList::empty() const {
+    return term_freqs_.empty();
+}
+
+uint16_t PostingList::QuantizeTermFreq(double term_freq) {
+    double scaled = std::ceil(term_freq * TERM_FREQ_SCALE);
+    //Округление при умножении не должно опустить результат ниже точного TF
+    if (scaled / TERM_FREQ_SCALE < term_freq) {
+        scaled += 1;
+    }
+    return static_cast<uint16_t>(std::clamp(scaled, 1.0, TERM_FREQ_SCALE));
+}
+
+double PostingList::DequantizeTermFreq(uint16_t quantized_term_freq) {
+    return quantized_term_freq / TERM_FREQ_SCALE;
+}
+
+void PostingList::Append(int ordinal, double term_freq) {
+    AppendQuantized(ordinal, QuantizeTermFreq(term_freq));
+}
+
+void PostingList::AppendQuantized(int ordinal, uint16_t term_freq) {
+    tail_ordinals_.push_back(ordinal);
+    term_freqs_.push_back(term_freq);
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    if (tail_ordinals_.size() < static_cast<size_t>(BLOCK_SIZE)) {
+        return;
+    }
+    //Хранятся разности минус один: номера строго возрастают
+    uint32_t deltas[BLOCK_SIZE];
+    int previous = block_last_ordinals_.empty() ? -1 : block_last_ordinals_.back();
+    uint32_t max_delta = 0;
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        deltas[i] = static_cast<uint32_t>(tail_ordinals_[i] - previous - 1);
+        max_delta = std::max(max_delta, deltas[i]);
+        previous = tail_ordinals_[i];
+    }
+    const int bit_width = GetBitWidth(max_delta);
+    packed_.resize(packed_.size() + bit_width * LANE_COUNT);
+    if (bit_width > 0) {
+        PackBlock(deltas, bit_width, packed_.data() + block_offsets_.back());
+    }
+    block_offsets_.push_back(static_cast<uint32_t>(packed_.size()));
+    block_last_ordinals_.push_back(tail_ordinals_.back());
+    tail_ordinals_.clear();
+}
+
+size_t PostingList::GetBlockCount() const {
+    return block_last_ordinals_.size() + (tail_ordinals_.empty() ? 0 : 1);
+}
+
+std::pair<const int*, int> PostingList::DecodeBlock(size_t block, int* buffer) const {
+    if (block == block_last_ordinals_.size()) {
+        return {tail_ordinals_.data(), static_cast<int>(tail_ordinals_.size())};
+    }
+    const int bit_width = static_cast<int>((block_offsets_[block + 1] - block_offsets_[block]) / LANE_COUNT);
+    uint32_t* deltas = reinterpret_cast<uint32_t*>(buffer);
+    UnpackBlock(packed_.data() + block_offsets_[block], bit_width, deltas);
+    int previous = block == 0 ? -1 : block_last_ordinals_[block - 1];
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        previous += static_cast<int>(deltas[i]) + 1;
+        buffer[i] = previous;
+    }
+    return {buffer, BLOCK_SIZE};
+}
+
+size_t PostingList::FindBlock(size_t from_block, int ordinal) const {
+    return static_cast<size_t>(std::lower_bound(block_last_ordinals_.begin() + from_block, block_last_ordinals_.end(), ordinal)
+                               - block_last_ordinals_.begin());
+}
+
+size_t PostingList::LowerBound(int ordinal) const {
+    const size_t block = FindBlock(0, ordinal);
+    if (block == GetBlockCount()) {
+        return size();
+    }
+    int buffer[BLOCK_SIZE];
+    const auto [ordinals, count] = DecodeBlock(block, buffer);
+    return block * BLOCK_SIZE + (std::lower_bound(ordinals, ordinals + count, ordinal) - ordinals);
+}
+
+int PostingList::Find(int ordinal) const {
+    const size_t block = FindBlock(0, ordinal);
+    if (block == GetBlockCount()) {
+        return -1;
+    }
+    int buffer[BLOCK_SIZE];
+    const auto [ordinals, count] = DecodeBlock(block, buffer);
+    const int* it = std::lower_bound(ordinals, ordinals + count, ordinal);
+    if (it == ordinals + count || *it != ordinal) {
+        return -1;
+    }
+    return static_cast<int>(block * BLOCK_SIZE + (it - ordinals));
+}
+
+void PostingList::Decode(std::vector<int>& ordinals) const {
+    int buffer[BLOCK_SIZE];
+    for (size_t block = 0; block < GetBlockCount(); ++block) {
+        const auto [block_ordinals, count] = DecodeBlock(block, buffer);
+        ordinals.insert(ordinals.end(), block_ordinals, block_ordinals + count);
+    }
+}
+
+bool PostingList::Validate() {
+    const size_t block_count = block_last_ordinals_.size();
+    if (block_offsets_.size() != block_count + 1 || block_offsets_.front() != 0 || block_offsets_.back() != packed_.size()
+        || tail_ordinals_.size() >= static_cast<size_t>(BLOCK_SIZE) || term_freqs_.size() != block_count * BLOCK_SIZE + tail_ordinals_.size()) {
+        return false;
+    }
+    //Номера считаются в int64_t: испорченные разности не должны переполнить int
+    int64_t previous = -1;
+    uint32_t deltas[BLOCK_SIZE];
+    for (size_t block = 0; block < block_count; ++block) {
+        const uint32_t begin = block_offsets_[block];
+        const uint32_t end = block_offsets_[block + 1];
+        if (begin > end || (end - begin) % LANE_COUNT != 0 || (end - begin) / LANE_COUNT > 32) {
+            return false;
+        }
+        UnpackBlock(packed_.data() + begin, static_cast<int>((end - begin) / LANE_COUNT), deltas);
+        for (const uint32_t delta : deltas) {
+            previous += static_cast<int64_t>(delta) + 1;
+        }
+        if (previous != block_last_ordinals_[block]) {
+            return false;
+        }
+    }
+    for (const int ordinal : tail_ordinals_) {
+        if (ordinal <= previous) {
+            return false;
+        }
+        previous = ordinal;
+    }
+    max_term_freq_ = 0;
+    for (const uint16_t term_freq : term_freqs_) {
+        if (term_freq == 0) {
+            return false;
+        }
+        max_term_freq_ = std::max(max_term_freq_, term_freq);
+    }
+    return true;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return DequantizeTermFreq(max_term_freq_);
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return block_last_ordinals_.size() * sizeof(int) + block_offsets_.size() * sizeof(uint32_t) + packed_.size() * sizeof(uint32_t)
+           + tail_ordinals_.size() * sizeof(int) + term_freqs_.size() * sizeof(uint16_t);
+}
+
+void PostingCursor::Reset(const PostingList& postings) {
+    postings_ = &postings;
+    block_count_ = postings.GetBlockCount();
+    index_ = 0;
+    count_ = 0;
+    block_ = 0;
+    if (block_count_ > 0) {
+        LoadBlock(0);
+    }
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    index_ = 0;
+    std::tie(ordinals_, count_) = postings_->DecodeBlock(block, buffer_);
+}
+
+void PostingCursor::Seek(int ordinal) {
+    if (AtEnd() || Ordinal() >= ordinal) {
+        return;
+    }
+    if (ordinals_[count_ - 1] < ordinal) {
+        const size_t block = block_ + 1 < block_count_ ? postings_->FindBlock(block_ + 1, ordinal) : block_count_;
+        if (block >= block_count_) {
+            //Position() в конце листа должна быть равна его размеру
+            if (block_ + 1 != block_count_) {
+                LoadBlock(block_count_ - 1);
+            }
+            index_ = count_;
+            return;
+        }
+        LoadBlock(block);
+    }
+    index_ = static_cast<int>(std::lower_bound(ordinals_ + index_, ordinals_ + count_, ordinal) - ordinals_);
+}
+
+TermStats::TermStats(const TermStats& other)
+    : document_freq(other.document_freq)
+    , idf_generation_(other.idf_generation_.load(std::memory_order_acquire))
+    , idf_(other.idf_.load(std::memory_order_relaxed)) {
+}
+
+TermStats& TermStats::operator=(const TermStats& other) {
+    document_freq = other.document_freq;
+    idf_.store(other.idf_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    idf_generation_.store(other.idf_generation_.load(std::memory_order_acquire), std::memory_order_release);
+    return *this;
+}
+
+double TermStats::GetInverseDocumentFreq(int document_count, uint64_t generation) const {
+    if (idf_generation_.load(std::memory_order_acquire) == generation) {
+        return idf_.load(std::memory_order_relaxed);
+    }
+    const double idf = ComputeInverseDocumentFreq(document_count, document_freq);
+    idf_.store(idf, std::memory_order_relaxed);
+    idf_generation_.store(generation, std::memory_order_release);
+    return idf;
+}
+
+double TermStats::ComputeInverseDocumentFreq(int document_count, int document_freq) {
+    return std::log(document_count * 1.0 / document_freq);
+}
+
+int InvertedIndex::InternTerm(std::string_view word) {
+    const int term_id = terms_.Intern(word);
+    if (static_cast<size_t>(term_id) == postings_.size()) {
+        postings_.emplace_back();
+        stats_.emplace_back();
+    }
+    return term_id;
+}
+
+int InvertedIndex::FindTerm(std::string_view word) const {
+    return terms_.Find(word);
+}
+
+std::string_view InvertedIndex::GetTerm(int term_id) const {
+    return terms_.GetTerm(term_id);
+}
+
+const PostingList& InvertedIndex::GetPostings(int term_id) const {
+    return postings_[term_id];
+}
+
+const TermStats& InvertedIndex::GetStats(int term_id) const {
+    return stats_[term_id];
+}
+
+void InvertedIndex::AddPosting(int term_id, int ordinal, double term_freq) {
+    postings_[term_id].Append(ordinal, term_freq);
+    ++stats_[term_id].document_freq;
+}
+
+void InvertedIndex::RetirePosting(int term_id) {
+    --stats_[term_id].document_freq;
+}
+
+void InvertedIndex::Compact(const std::vector<int>& new_ordinals) {
+    std::vector<int> ordinals;
+    for (PostingList& postings : postings_) {
+        ordinals.clear();
+        postings.Decode(ordinals);
+        PostingList compacted;
+        for (size_t pos = 0; pos < ordinals.size(); ++pos) {
+            const int new_ordinal = new_ordinals[ordinals[pos]];
+            if (new_ordinal >= 0) {
+                compacted.AppendQuantized(new_ordinal, postings.term_freqs_[pos]);
+            }
+        }
+        postings = std::move(compacted);
+    }
+}
+
+size_t InvertedIndex::GetTermCount() const {
+    return terms_.size();
+}
+
+size_t InvertedIndex::GetPostingMemoryUsage() const {
+    size_t bytes = 0;
+    for (const PostingList& postings : postings_) {
+        bytes += postings.GetMemoryUsage();
+    }
+    return bytes;
+}
+
+size_t InvertedIndex::GetTermMemoryUsage() const {
+    return terms_.GetMemoryUsage();
+}
+
+void InvertedIndex::Save(SnapshotWriter& writer) const {
+    writer.WriteStrings(terms_);
+    //Порядок слов в словаре, при загрузке по нему проверяется восстановленный словарь
+    const std::vector<int> sorted_term_ids = terms_.GetSortedIds();
+    writer.WriteArray(sorted_term_ids);
+
+    //Листы пишутся в упакованном виде, массивы всех листов подряд. Длины частей листа выводятся из
+    //числа его постингов: полных блоков size / BLOCK_SIZE, в хвосте - остаток, упакованных слов - последнее смещение блока
+    std::vector<int32_t> document_freqs;
+    std::vector<uint64_t> posting_offsets = {0};
+    std::vector<int32_t> block_last_ordinals;
+    std::vector<uint32_t> block_offsets;
+    std::vector<uint32_t> packed;
+    std::vector<int32_t> tail_ordinals;
+    std::vector<uint16_t> term_freqs;
+    for (size_t term_id = 0; term_id < postings_.size(); ++term_id) {
+        const PostingList& postings = postings_[term_id];
+        document_freqs.push_back(stats_[term_id].document_freq);
+        posting_offsets.push_back(posting_offsets.back() + postings.size());
+        block_last_ordinals.insert(block_last_ordinals.end(), postings.block_last_ordinals_.begin(), postings.block_last_ordinals_.end());
+        block_offsets.insert(block_offsets.end(), postings.block_offsets_.begin(), postings.block_offsets_.end());
+        packed.insert(packed.end(), postings.packed_.begin(), postings.packed_.end());
+        tail_ordinals.insert(tail_ordinals.end(), postings.tail_ordinals_.begin(), postings.tail_ordinals_.end());
+        term_freqs.insert(term_freqs.end(), postings.term_freqs_.begin(), postings.term_freqs_.end());
+    }
+    writer.WriteArray(document_freqs);
+    writer.WriteArray(posting_offsets);
+    writer.WriteArray(block_last_ordinals);
+    writer.WriteArray(block_offsets);
+    writer.WriteArray(packed);
+    writer.WriteArray(tail_ordinals);
+    writer.WriteArray(term_freqs);
+}
+
+size_t InvertedIndex::Load(SnapshotReader& reader) {
+    //Индекс не содержит пустых слов: их не порождает разбиение текста на слова
+    bool has_invalid_terms = false;
+    reader.ReadStrings([this, &has_invalid_terms](std::string_view term) {
+        has_invalid_terms = has_invalid_terms || term.empty() || static_cast<size_t>(terms_.Intern(term)) + 1 != terms_.size();
+    });
+    const size_t term_count = terms_.size();
+    std::vector<int32_t> sorted_term_ids;
+    reader.ReadArray(sorted_term_ids);
+    std::vector<int32_t> document_freqs;
+    reader.ReadArray(document_freqs);
+    std::vector<uint64_t> posting_offsets;
+    reader.ReadArray(posting_offsets);
+    std::vector<int32_t> block_last_ordinals;
+    reader.ReadArray(block_last_ordinals);
+    std::vector<uint32_t> block_offsets;
+    reader.ReadArray(block_offsets);
+    std::vector<uint32_t> packed;
+    reader.ReadArray(packed);
+    std::vector<int32_t> tail_ordinals;
+    reader.ReadArray(tail_ordinals);
+    std::vector<uint16_t> term_freqs;
+    reader.ReadArray(term_freqs);
+    if (has_invalid_terms || sorted_term_ids != terms_.GetSortedIds() || document_freqs.size() != term_count
+        || posting_offsets.size() != term_count + 1 || posting_offsets.front() != 0 || posting_offsets.back() != term_freqs.size()) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+
+    postings_.resize(term_count);
+    stats_.resize(term_count);
+    size_t ordinal_bound = 0;
+    //Начала частей текущего листа в общих массивах
+    size_t block_pos = 0;
+    size_t block_offset_pos = 0;
+    size_t packed_pos = 0;
+    size_t tail_pos = 0;
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        const uint64_t begin = posting_offsets[term_id];
+        const uint64_t end = posting_offsets[term_id + 1];
+        if (begin > end || end > term_freqs.size()) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        const size_t block_count = (end - begin) / PostingList::BLOCK_SIZE;
+        const size_t tail_size = (end - begin) % PostingList::BLOCK_SIZE;
+        if (block_pos + block_count > block_last_ordinals.size() || block_offset_pos + block_count + 1 > block_offsets.size()
+            || tail_pos + tail_size > tail_ordinals.size()) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        const size_t packed_size = block_offsets[block_offset_pos + block_count];
+        if (packed_size > packed.size() - packed_pos) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        PostingList& postings = postings_[term_id];
+        postings.block_last_ordinals_.assign(block_last_ordinals.begin() + block_pos, block_last_ordinals.begin() + block_pos + block_count);
+        postings.block_offsets_.assign(block_offsets.begin() + block_offset_pos, block_offsets.begin() + block_offset_pos + block_count + 1);
+        postings.packed_.assign(packed.begin() + packed_pos, packed.begin() + packed_pos + packed_size);
+        postings.tail_ordinals_.assign(tail_ordinals.begin() + tail_pos, tail_ordinals.begin() + tail_pos + tail_size);
+        postings.term_freqs_.assign(term_freqs.begin() + begin, term_freqs.begin() + end);
+        if (!postings.Validate()) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        block_pos += block_count;
+        block_offset_pos += block_count + 1;
+        packed_pos += packed_size;
+        tail_pos += tail_size;
+        //Номера в постинге возрастают, поэтому наибольший из них последний
+        if (!postings.empty()) {
+            const int last_ordinal = tail_size > 0 ? postings.tail_ordinals_.back() : postings.block_last_ordinals_.back();
+            ordinal_bound = std::max(ordinal_bound, static_cast<size_t>(last_ordinal) + 1);
+        }
+        stats_[term_id].document_freq = document_freqs[term_id];
+    }
+    if (block_pos != block_last_ordinals.size() || block_offset_pos != block_offsets.size() || packed_pos != packed.size()
+        || tail_pos != tail_ordinals.size()) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+    return ordinal_bound;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "term_dictionary.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+//Постинг-лист одного слова: возрастающие порядковые номера документов и TF слова в них.
+//Номера хранятся блоками по BLOCK_SIZE: разности соседних номеров упакованы минимальным для блока числом бит
+//в "вертикальной" раскладке (4 чередующиеся 32-битные полосы), которая распаковывается SIMD-инструкциями.
+//Последний неполный блок хранится без сжатия. TF хранится в 16-битной фиксированной точке с округлением вверх,
+//поэтому TF из листа - верхняя граница точного TF и годится только для оценок при отсечении
+class PostingList {
+public:
+    static constexpr int BLOCK_SIZE = 128;
+
+    size_t size() const;
+    bool empty() const;
+
+    //ordinal должен быть больше всех уже добавленных
+    void Append(int ordinal, double term_freq);
+    //Позиция документа в листе или -1
+    int Find(int ordinal) const;
+    //Позиция первого документа с номером не меньше ordinal
+    size_t LowerBound(int ordinal) const;
+    //Верхняя граница TF в листе, нужна для отсечения документов при поиске
+    double GetMaxTermFreq() const;
+    //Байты, занятые листом, без учёта резерва векторов
+    size_t GetMemoryUsage() const;
+
+    static uint16_t QuantizeTermFreq(double term_freq);
+    static double DequantizeTermFreq(uint16_t quantized_term_freq);
+
+private:
+    friend class PostingCursor;
+    friend class InvertedIndex;
+
+    std::vector<int> block_last_ordinals_;
+    std::vector<uint32_t> block_offsets_ = {0}; //Начало блока в packed_, ширина блока в битах - (offsets[b + 1] - offsets[b]) / 4
+    std::vector<uint32_t> packed_;
+    std::vector<int> tail_ordinals_;
+    std::vector<uint16_t> term_freqs_; //Для всех постингов листа
+    uint16_t max_term_freq_ = 0;
+
+    void AppendQuantized(int ordinal, uint16_t term_freq);
+    size_t GetBlockCount() const; //Включая неполный последний блок
+    //Распаковывает номера блока в buffer, возвращает указатель на номера и их число
+    std::pair<const int*, int> DecodeBlock(size_t block, int* buffer) const;
+    size_t FindBlock(size_t from_block, int ordinal) const;
+    //Дописывает все номера листа в ordinals
+    void Decode(std::vector<int>& ordinals) const;
+    //Проверяет лист, скопированный из снимка: ширины блоков, строгое возрастание номеров от нуля
+    //и ненулевые TF. Пересчитывает max_term_freq_
+    bool Validate();
+};
+
+//Последовательный обход постинг-листа с распаковкой по одному блоку.
+//Seek двигается только вперёд, поэтому каждый блок распаковывается не больше одного раза
+class PostingCursor {
+public:
+    void Reset(const PostingList& postings);
+
+    bool AtEnd() const {
+        return index_ >= count_;
+    }
+    int Ordinal() const {
+        return ordinals_[index_];
+    }
+    //Верхняя граница TF, см. PostingList
+    double TermFreq() const {
+        return PostingList::DequantizeTermFreq(postings_->term_freqs_[Position()]);
+    }
+    size_t Position() const {
+        return block_ * PostingList::BLOCK_SIZE + index_;
+    }
+    void Next() {
+        if (++index_ == count_ && block_ + 1 < block_count_) {
+            LoadBlock(block_ + 1);
+        }
+    }
+    //Переходит к первому документу с номером не меньше ordinal
+    void Seek(int ordinal);
+
+private:
+    const PostingList* postings_ = nullptr;
+    size_t block_ = 0;
+    size_t block_count_ = 0;
+    const int* ordinals_ = nullptr;
+    int index_ = 0;
+    int count_ = 0;
+    int buffer_[PostingList::BLOCK_SIZE];
+
+    void LoadBlock(size_t block);
+};
+
+//Статистика слова для ранжирования: число содержащих его документов и закешированный IDF.
+//IDF пересчитывается лениво при первом обращении после смены поколения индекса,
+//одновременный пересчёт из нескольких потоков записывает одно и то же значение
+class TermStats {
+public:
+    TermStats() = default;
+    TermStats(const TermStats& other);
+    TermStats& operator=(const TermStats& other);
+
+    int document_freq = 0;
+
+    //generation меняется при любом изменении набора документов, 0 зарезервирован за "не вычислено"
+    double GetInverseDocumentFreq(int document_count, uint64_t generation) const;
+
+    //Единая формула IDF, чтобы значения, посчитанные по разным индексам, совпадали до бита
+    static double ComputeInverseDocumentFreq(int document_count, int document_freq);
+
+private:
+    mutable std::atomic<uint64_t> idf_generation_ = 0;
+    mutable std::atomic<double> idf_ = 0;
+};
+
+//Словарь слов с плотными идентификаторами и постинг-листы по этим идентификаторам.
+//Слова из словаря не удаляются, поэтому string_view на них остаются валидными всё время жизни индекса
+class InvertedIndex {
+public:
+    static constexpr int NO_TERM = TermDictionary::NO_TERM;
+
+    int InternTerm(std::string_view word);
+    int FindTerm(std::string_view word) const;
+    std::string_view GetTerm(int term_id) const;
+    //Вызывает func(term_id) для слов словаря, начинающихся с prefix, в неопределённом порядке
+    template <typename Func>
+    void ForEachTermWithPrefix(std::string_view prefix, Func func) const {
+        terms_.ForEachWithPrefix(prefix, func);
+    }
+
+    const PostingList& GetPostings(int term_id) const;
+    const TermStats& GetStats(int term_id) const;
+
+    //Поддерживают постинг-лист и статистику слова согласованными
+    void AddPosting(int term_id, int ordinal, double term_freq);
+    //Документ удалён, но его постинг остаётся в листе до Compact: уменьшается только document_freq
+    void RetirePosting(int term_id);
+    //Удаляет постинги документов с new_ordinals[ordinal] < 0, остальные перенумеровывает.
+    //Перенумерация должна быть возрастающей, чтобы листы остались отсортированными
+    void Compact(const std::vector<int>& new_ordinals);
+
+    size_t GetTermCount() const;
+    size_t GetPostingMemoryUsage() const;
+    size_t GetTermMemoryUsage() const;
+
+    void Save(SnapshotWriter& writer) const;
+    //Только для пустого индекса. Постинг-листы копируются в упакованном виде и проверяются распаковкой,
+    //словарь строится заново. Возвращает число, большее всех номеров документов в постингах,
+    //чтобы вызывающий сверил его с числом загруженных документов
+    size_t Load(SnapshotReader& reader);
+
+private:
+    TermDictionary terms_;
+    std::vector<PostingList> postings_;
+    std::vector<TermStats> stats_;
+};
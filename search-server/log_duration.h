@@ -2,8 +2,11 @@
 
 #include <chrono>
 #include <iostream>
+#include <optional>
 #include <string_view>
 
+#include "metrics.h"
+
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
@@ -46,6 +49,18 @@
  */
 #define LOG_DURATION_STREAM(x, y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
 
+/**
+ * Записывает время до конца блока в гистограмму задержек вместо вывода в поток.
+ * Стоит два чтения часов и запись в гистограмму, поэтому годится для постоянного учёта.
+ *
+ * Пример использования:
+ *
+ *  LatencyHistogram& latency = registry.GetHistogram("find_top_documents"sv);
+ *  ...
+ *  LOG_LATENCY(latency);
+ */
+#define LOG_LATENCY(histogram) LogDuration UNIQUE_VAR_NAME_PROFILE(histogram)
+
 class LogDuration {
 public:
     // заменим имя типа std::chrono::steady_clock
@@ -54,7 +69,11 @@ public:
 
     LogDuration(std::string_view id, std::ostream& dst_stream = std::cerr)
         : id_(id)
-        , dst_stream_(dst_stream) {
+        , dst_stream_(&dst_stream) {
+    }
+
+    explicit LogDuration(LatencyHistogram& histogram)
+        : histogram_(&histogram) {
     }
 
     ~LogDuration() {
@@ -63,11 +82,24 @@ public:
 
         const auto end_time = Clock::now();
         const auto dur = end_time - start_time_;
-        dst_stream_ << id_ << ": "sv << duration_cast<milliseconds>(dur).count() << " ms"sv << std::endl;
+        if (histogram_ != nullptr) {
+            histogram_->Record(duration_cast<nanoseconds>(dur).count());
+        } else {
+            *dst_stream_ << id_ << ": "sv << duration_cast<milliseconds>(dur).count() << " ms"sv << std::endl;
+        }
     }
 
 private:
     const std::string id_;
+    std::ostream* const dst_stream_ = nullptr;
+    LatencyHistogram* const histogram_ = nullptr;
     const Clock::time_point start_time_ = Clock::now();
-    std::ostream& dst_stream_;
 };
+
+//Замер в histogram до конца жизни результата, без замера, если histogram == nullptr. Для необязательных метрик
+inline std::optional<LogDuration> MeasureLatency(LatencyHistogram* histogram) {
+    if (histogram == nullptr) {
+        return std::nullopt;
+    }
+    return std::optional<LogDuration>(std::in_place, *histogram);
+}
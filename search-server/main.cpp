@@ -1,13 +1,56 @@
+#include <atomic>
+#include <cstdlib>
+#include <deque>
 #include <execution>
+#include <filesystem>
 #include <iostream>
+#include <map>
+#include <new>
+#include <optional>
 #include <random>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "concurrent_search_server.h"
 #include "search_server.h"
+#include "thread_pool.h"
+#include "sharded_search_server.h"
+#include "term_dictionary.h"
 #include "log_duration.h"
 
 using namespace std;
+
+//Счётчики обращений к глобальному аллокатору и выделенных байт для замера выделений памяти
+static atomic<size_t> allocation_count = 0;
+static atomic<size_t> allocated_bytes = 0;
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    allocated_bytes.fetch_add(size, memory_order_relaxed);
+    if (void* ptr = malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+//GCC 12 считает free несовместимым с operator new, встроив оба в код контейнеров, хотя operator new выше берёт память у malloc
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
 string GenerateWord(mt19937& generator, int max_length) {
     const int length = uniform_int_distribution(1, max_length)(generator);
     string word;
@@ -47,6 +90,27 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
     }
     return queries;
 }
+//Слова выбираются по закону Ципфа: частота слова обратно пропорциональна его номеру в словаре
+vector<string> GenerateSkewedQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int word_count) {
+    vector<double> weights(dictionary.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1.0 / (i + 1);
+    }
+    discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        string query;
+        for (int j = 0; j < word_count; ++j) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+            query += dictionary[word_distribution(generator)];
+        }
+        queries.push_back(query);
+    }
+    return queries;
+}
 template <typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
@@ -57,17 +121,478 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
         }
     }
     cout << total_relevance << endl;
+    const auto stats = search_server.GetPruningStats();
+    cout << "postings skipped: "s << stats.postings_total - stats.postings_traversed << " of "s << stats.postings_total
+         << ", probed: "s << stats.postings_probed << endl;
+}
+void TestAllocations(const SearchServer& search_server, const vector<string>& queries) {
+    //Первый проход прогревает переиспользуемые буферы и арены запросов
+    const auto count_allocations = [&queries](const string& name, const auto& func) {
+        for (const string& query : queries) {
+            func(query);
+        }
+        const size_t before = allocation_count;
+        for (const string& query : queries) {
+            func(query);
+        }
+        cout << name << " allocations per query: "s << (allocation_count - before) * 1.0 / queries.size() << endl;
+    };
+    count_allocations("FindTopDocuments"s, [&search_server](const string& query) {
+        search_server.FindTopDocuments(query);
+    });
+    count_allocations("FindTopDocuments(par)"s, [&search_server](const string& query) {
+        search_server.FindTopDocuments(execution::par, query);
+    });
+    count_allocations("MatchDocument"s, [&search_server](const string& query) {
+        search_server.MatchDocument(query, 0);
+    });
+    //Пакет из одного запроса: выдача пакета выделяется один раз на вызов
+    count_allocations("FindTopDocumentsBatch"s, [&search_server](const string& query) {
+        search_server.FindTopDocumentsBatch(execution::seq, {query});
+    });
+}
+//Прежний побайтовый токенизатор, для сравнения с блочным
+vector<string> ScalarSplitIntoWords(const string& text) {
+    vector<string> words;
+    string word;
+    for (const char c : text) {
+        if (c == ' ') {
+            if (!word.empty()) {
+                words.push_back(word);
+                word.clear();
+            }
+        } else {
+            word += c;
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+    return words;
+}
+template <typename Func>
+void ScalarForEachCheckedWord(string_view text, Func func) {
+    size_t pos = text.find_first_not_of(' ');
+    while (pos != string_view::npos) {
+        const size_t space = text.find(' ', pos);
+        const string_view word = text.substr(pos, space == string_view::npos ? space : space - pos);
+        func(word, none_of(word.begin(), word.end(), [](char c) {
+            return c >= '\0' && c < ' ';
+        }));
+        if (space == string_view::npos) {
+            return;
+        }
+        pos = text.find_first_not_of(' ', space);
+    }
+}
+void BenchmarkTokenizer(const vector<string>& texts) {
+    const int repeat_count = 5;
+    size_t word_count = 0;
+    {
+        LOG_DURATION("SplitIntoWords scalar"sv);
+        for (int i = 0; i < repeat_count; ++i) {
+            for (const string& text : texts) {
+                word_count += ScalarSplitIntoWords(text).size();
+            }
+        }
+    }
+    {
+        LOG_DURATION("SplitIntoWords block"sv);
+        for (int i = 0; i < repeat_count; ++i) {
+            for (const string& text : texts) {
+                word_count -= SplitIntoWords(text).size();
+            }
+        }
+    }
+    const auto count_valid = [&word_count](string_view word, bool is_valid) {
+        word_count += word.size() + is_valid;
+    };
+    {
+        LOG_DURATION("tokenize+validate scalar"sv);
+        for (int i = 0; i < repeat_count; ++i) {
+            for (const string& text : texts) {
+                ScalarForEachCheckedWord(text, count_valid);
+            }
+        }
+    }
+    const size_t scalar_count = word_count;
+    word_count = 0;
+    {
+        LOG_DURATION("tokenize+validate block"sv);
+        for (int i = 0; i < repeat_count; ++i) {
+            for (const string& text : texts) {
+                ForEachCheckedWord(text, count_valid);
+            }
+        }
+    }
+    cout << "tokenizers agree: "s << boolalpha << (scalar_count == word_count) << endl;
+}
+//Параллельные перегрузки на std::execution::par и на встроенном пуле потоков
+void BenchmarkThreadPool(const vector<string>& stop_words, const vector<string>& documents, const vector<string>& queries) {
+    ThreadPool thread_pool;
+    for (ThreadPool* pool : {static_cast<ThreadPool*>(nullptr), &thread_pool}) {
+        const string backend = pool == nullptr ? "std::execution::par"s : "ThreadPool("s + to_string(pool->GetConcurrency()) + ")"s;
+        SearchServer search_server(stop_words);
+        search_server.SetThreadPool(pool);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        double total_relevance = 0;
+        {
+            LOG_DURATION(backend + " FindTopDocuments"s);
+            for (const string_view query : queries) {
+                for (const auto& document : search_server.FindTopDocuments(execution::par, query)) {
+                    total_relevance += document.relevance;
+                }
+            }
+        }
+        size_t word_count = 0;
+        {
+            LOG_DURATION(backend + " MatchDocument"s);
+            for (int id = 0; id < 1000; ++id) {
+                word_count += get<0>(search_server.MatchDocument(execution::par, queries[id % queries.size()], id)).size();
+            }
+        }
+        {
+            LOG_DURATION(backend + " ProcessQueries"s);
+            for (const auto& documents : ProcessQueries(search_server, queries)) {
+                for (const Document& document : documents) {
+                    total_relevance += document.relevance;
+                }
+            }
+        }
+        {
+            LOG_DURATION(backend + " RemoveDocument"s);
+            for (int id = 0; id < static_cast<int>(documents.size()); id += 2) {
+                search_server.RemoveDocument(execution::par, id);
+            }
+        }
+        cout << total_relevance << ", matched words: "s << word_count << endl;
+    }
+}
+//Прежний поиск дубликатов сравнением копий множеств слов, для сравнения с отпечатками
+vector<int> SetBasedFindDuplicates(const SearchServer& search_server) {
+    vector<int> duplicates;
+    set<set<string_view>> word_sets;
+    for (const int document_id : search_server) {
+        set<string_view> words;
+        for (const auto& [word, term_freq] : search_server.GetWordFrequencies(document_id)) {
+            words.insert(word);
+        }
+        if (!word_sets.insert(words).second) {
+            duplicates.push_back(document_id);
+        }
+    }
+    return duplicates;
+}
+void BenchmarkDuplicates(const string& stop_words, const vector<string>& documents) {
+    SearchServer search_server(stop_words);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1});
+    }
+    //Каждый третий документ повторяется, каждый пятый повторяется с одним лишним словом
+    int next_id = documents.size();
+    for (size_t i = 0; i < documents.size(); i += 3) {
+        search_server.AddDocument(next_id++, documents[i], DocumentStatus::ACTUAL, {1});
+    }
+    for (size_t i = 0; i < documents.size(); i += 5) {
+        search_server.AddDocument(next_id++, documents[i] + " extra"s, DocumentStatus::ACTUAL, {1});
+    }
+    vector<int> duplicates;
+    {
+        LOG_DURATION("set-based duplicates"sv);
+        duplicates = SetBasedFindDuplicates(search_server);
+    }
+    cout << duplicates.size() << " duplicates"s << endl;
+    {
+        LOG_DURATION("FindDuplicates"sv);
+        duplicates = FindDuplicates(search_server);
+    }
+    cout << duplicates.size() << " duplicates"s << endl;
+    vector<int> near_duplicates;
+    {
+        LOG_DURATION("FindNearDuplicates(0.9)"sv);
+        near_duplicates = FindNearDuplicates(search_server, {0.9, 16, 4});
+    }
+    cout << near_duplicates.size() << " near duplicates"s << endl;
+    {
+        LOG_DURATION("RemoveDocuments(duplicates)"sv);
+        search_server.RemoveDocuments(duplicates);
+    }
+}
+void BenchmarkIngestDeduplication(const string& stop_words, const vector<string>& documents) {
+    //Поток документов, 30% которого - повторы уже пришедших
+    mt19937 generator(19);
+    vector<const string*> feed;
+    for (const string& document : documents) {
+        feed.push_back(&document);
+        if (uniform_int_distribution(0, 9)(generator) < 4) {
+            feed.push_back(feed[uniform_int_distribution<size_t>(0, feed.size() - 1)(generator)]);
+        }
+    }
+    {
+        LOG_DURATION("ingest + RemoveDuplicates"sv);
+        SearchServer search_server(stop_words);
+        for (size_t i = 0; i < feed.size(); ++i) {
+            search_server.AddDocument(i, *feed[i], DocumentStatus::ACTUAL, {1});
+        }
+        search_server.RemoveDocuments(FindDuplicates(search_server));
+        cout << search_server.GetDocumentCount() << " of "s << feed.size() << " documents"s << endl;
+    }
+    {
+        LOG_DURATION("ingest with deduplication"sv);
+        SearchServer search_server(stop_words);
+        search_server.EnableIngestDeduplication();
+        for (size_t i = 0; i < feed.size(); ++i) {
+            search_server.AddDocument(i, *feed[i], DocumentStatus::ACTUAL, {1});
+        }
+        cout << search_server.GetDocumentCount() << " of "s << feed.size() << " documents"s << endl;
+    }
+}
+void BenchmarkMetrics(SearchServer& search_server, const vector<string>& queries) {
+    MetricsRegistry metrics;
+    LatencyHistogram& histogram = metrics.GetHistogram("benchmark.empty_scope_ns"sv);
+    const int iteration_count = 1'000'000;
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iteration_count; ++i) {
+        LOG_LATENCY(histogram);
+    }
+    const auto duration = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    cout << "LOG_LATENCY overhead: "s << duration / iteration_count << " ns"s << endl;
+
+    const auto run_queries = [&](string_view mark) {
+        LOG_DURATION(mark);
+        for (int repeat = 0; repeat < 10; ++repeat) {
+            for (const string& query : queries) {
+                search_server.FindTopDocuments(query);
+            }
+        }
+    };
+    run_queries("queries without metrics"sv);
+    search_server.SetMetrics(&metrics);
+    run_queries("queries with metrics"sv);
+    search_server.SetMetrics(nullptr);
+    metrics.DumpText(cout);
+}
+//Память словаря против прежних std::map<string_view, int> и std::deque<string>, поиск по шаблонам против точных слов
+void BenchmarkWordPatterns(const SearchServer& search_server, const vector<string>& dictionary) {
+    mt19937 generator(25);
+    const auto words = GenerateDictionary(generator, 200'000, 10);
+    size_t before = allocated_bytes;
+    {
+        map<string_view, int> term_to_id;
+        deque<string> terms;
+        for (const string& word : words) {
+            if (term_to_id.count(word) == 0) {
+                term_to_id[terms.emplace_back(word)] = static_cast<int>(terms.size());
+            }
+        }
+        //Контейнеры только растут, поэтому выделенное - это занятое
+        cout << "map dictionary: "s << (allocated_bytes - before) * 1.0 / terms.size() << " bytes per term"s << endl;
+    }
+    {
+        TermDictionary terms;
+        for (const string& word : words) {
+            terms.Intern(word);
+        }
+        cout << "TermDictionary: "s << terms.GetMemoryUsage() * 1.0 / terms.size() << " bytes per term"s << endl;
+    }
+
+    //Запросы из двухбуквенных префиксов слов словаря, как при автодополнении
+    vector<string> exact_queries;
+    vector<string> prefix_queries;
+    for (size_t i = 0; i < 1000; ++i) {
+        const string& word = dictionary[i * 7 % dictionary.size()];
+        exact_queries.push_back(word);
+        prefix_queries.push_back(word.substr(0, 2) + "*"s);
+    }
+    size_t document_count = 0;
+    {
+        LOG_DURATION("exact word queries"sv);
+        for (const string& query : exact_queries) {
+            document_count += search_server.FindTopDocuments(query).size();
+        }
+    }
+    {
+        LOG_DURATION("prefix queries"sv);
+        for (const string& query : prefix_queries) {
+            document_count += search_server.FindTopDocuments(query).size();
+        }
+    }
+    cout << document_count << endl;
 }
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 int main() {
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+    BenchmarkTokenizer(documents);
     SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    {
+        LOG_DURATION("AddDocument loop"sv);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+    {
+        vector<SearchServer::NewDocument> batch;
+        batch.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        SearchServer batch_server(dictionary[0]);
+        LOG_DURATION("AddDocuments(par)"sv);
+        batch_server.AddDocuments(execution::par, batch);
+    }
+    search_server.SaveSnapshot("search_server.snapshot"s);
+    {
+        optional<LogDuration> load_duration(in_place, "LoadSnapshot"sv);
+        const SearchServer loaded_server = SearchServer::LoadSnapshot("search_server.snapshot"s);
+        load_duration.reset();
+    }
+    filesystem::remove("search_server.snapshot"s);
+    {
+        const auto memory = search_server.GetMemoryStats();
+        cout << "postings: "s << memory.posting_count << ", "s << memory.posting_bytes << " bytes ("s
+             << static_cast<double>(memory.posting_bytes) / memory.posting_count << " per posting, uncompressed "s
+             << memory.posting_count * (sizeof(int) + sizeof(double)) << "), forward index: "s << memory.forward_index_bytes << " bytes, terms: "s
+             << memory.term_bytes << " bytes"s << endl;
     }
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
+    search_server.ResetPruningStats();
     TEST(par);
+    TestAllocations(search_server, queries);
+    BenchmarkMetrics(search_server, queries);
+    BenchmarkWordPatterns(search_server, dictionary);
+    {
+        SearchServer::QueryTrace trace;
+        search_server.FindTopDocumentsExplained(queries[0], trace);
+        trace.Print(cout);
+    }
+    BenchmarkThreadPool({dictionary[0]}, documents, queries);
+    BenchmarkDuplicates(dictionary[0], documents);
+    BenchmarkIngestDeduplication(dictionary[0], documents);
+    {
+        //Матчинг всех документов по 10 запросам: прежний цикл по MatchDocument и пакетный проход по постингам
+        size_t word_count = 0;
+        {
+            LOG_DURATION("MatchDocument loop"sv);
+            for (size_t i = 0; i < 10; ++i) {
+                for (const int document_id : search_server) {
+                    word_count += get<0>(search_server.MatchDocument(queries[i], document_id)).size();
+                }
+            }
+        }
+        cout << word_count << " words"s << endl;
+        word_count = 0;
+        {
+            LOG_DURATION("MatchDocuments(par)"sv);
+            for (size_t i = 0; i < 10; ++i) {
+                word_count += search_server.MatchDocuments(execution::par, queries[i]).words.size();
+            }
+        }
+        cout << word_count << " words"s << endl;
+    }
+    {
+        ConcurrentSearchServer concurrent_server(dictionary[0]);
+        vector<SearchServer::NewDocument> batch;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        concurrent_server.AddDocuments(batch);
+        const auto run_queries = [&](string_view mark) {
+            LOG_DURATION(mark);
+            double total_relevance = 0;
+            for (const string_view query : queries) {
+                for (const auto& document : concurrent_server.FindTopDocuments(query)) {
+                    total_relevance += document.relevance;
+                }
+            }
+            cout << total_relevance << endl;
+        };
+        run_queries("ConcurrentSearchServer queries"sv);
+        thread writer([&concurrent_server] {
+            for (int id = 0; id < 1000; ++id) {
+                concurrent_server.RemoveDocument(id);
+            }
+        });
+        run_queries("ConcurrentSearchServer queries during RemoveDocument x1000"sv);
+        writer.join();
+    }
+
+    SearchServer skewed_server(dictionary[0]);
+    const auto skewed_documents = GenerateSkewedQueries(generator, dictionary, 10'000, 70);
+    for (size_t i = 0; i < skewed_documents.size(); ++i) {
+        skewed_server.AddDocument(i, skewed_documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    const auto skewed_queries = GenerateSkewedQueries(generator, dictionary, 1'000, 7);
+    Test("skewed seq"sv, skewed_server, skewed_queries, execution::seq);
+    {
+        optional<LogDuration> duration(in_place, "skewed batch seq"sv);
+        const auto batch = skewed_server.FindTopDocumentsBatch(execution::seq, skewed_queries);
+        duration.reset();
+        double total_relevance = 0;
+        for (const Document& document : batch.documents) {
+            total_relevance += document.relevance;
+        }
+        cout << total_relevance << endl;
+    }
+    {
+        LOG_DURATION("skewed ProcessQueries"sv);
+        ProcessQueries(skewed_server, skewed_queries);
+    }
+    {
+        ShardedSearchServer sharded_server(dictionary[0], 4);
+        vector<SearchServer::NewDocument> batch;
+        for (size_t i = 0; i < skewed_documents.size(); ++i) {
+            batch.push_back({static_cast<int>(i), skewed_documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        sharded_server.AddDocuments(batch);
+        LOG_DURATION("skewed 4 shards par"sv);
+        double total_relevance = 0;
+        for (const string_view query : skewed_queries) {
+            for (const auto& document : sharded_server.FindTopDocuments(execution::par, query)) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
+    {
+        LOG_DURATION("RemoveDocument x5000"sv);
+        for (int id = 0; id < 10'000; id += 2) {
+            skewed_server.RemoveDocument(id);
+        }
+    }
+    Test("skewed seq after removal"sv, skewed_server, skewed_queries, execution::seq);
+    {
+        LOG_DURATION("CompactIndex"sv);
+        skewed_server.CompactIndex();
+    }
+    Test("skewed seq after compaction"sv, skewed_server, skewed_queries, execution::seq);
+
+    //Поток из повторяющихся запросов: номера запросов тоже распределены по Ципфу
+    vector<string> repeated_queries;
+    {
+        vector<double> weights(skewed_queries.size());
+        for (size_t i = 0; i < weights.size(); ++i) {
+            weights[i] = 1.0 / (i + 1);
+        }
+        discrete_distribution<int> query_distribution(weights.begin(), weights.end());
+        for (int i = 0; i < 20'000; ++i) {
+            repeated_queries.push_back(skewed_queries[query_distribution(generator)]);
+        }
+    }
+    for (const size_t cache_bytes : {size_t(0), DEFAULT_QUERY_CACHE_BYTES}) {
+        RequestQueue request_queue(skewed_server, cache_bytes);
+        optional<LogDuration> duration(in_place, cache_bytes == 0 ? "RequestQueue without cache"sv : "RequestQueue with cache"sv);
+        size_t document_count = 0;
+        for (const string& query : repeated_queries) {
+            document_count += request_queue.AddFindRequest(query).size();
+        }
+        duration.reset();
+        const auto stats = request_queue.GetCacheStats();
+        cout << document_count << " documents, cache hits: "s << stats.hits << ", misses: "s << stats.misses
+             << ", bytes: "s << stats.bytes << endl;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "metrics.h"
+
+#include <cmath>
+
+namespace {
+
+template <typename Metric>
+Metric& GetOrCreate(std::map<std::string, std::unique_ptr<Metric>, std::less<>>& metrics, std::string_view name) {
+    auto it = metrics.find(name);
+    if (it == metrics.end()) {
+        it = metrics.emplace(std::string(name), std::make_unique<Metric>()).first;
+    }
+    return *it->second;
+}
+
+void WriteHistogramFields(std::ostream& out, const LatencyHistogram::Snapshot& snapshot, std::string_view separator,
+                          std::string_view quote) {
+    using namespace std::literals;
+    out << quote << "count"sv << quote << separator << snapshot.count << ", "sv
+        << quote << "mean_ns"sv << quote << separator << (snapshot.count > 0 ? snapshot.sum_ns / snapshot.count : 0) << ", "sv
+        << quote << "p50_ns"sv << quote << separator << snapshot.GetPercentile(0.5) << ", "sv
+        << quote << "p99_ns"sv << quote << separator << snapshot.GetPercentile(0.99) << ", "sv
+        << quote << "p999_ns"sv << quote << separator << snapshot.GetPercentile(0.999) << ", "sv
+        << quote << "max_ns"sv << quote << separator << snapshot.GetPercentile(1.0);
+}
+
+}
+
+size_t GetMetricsShard() {
+    static std::atomic<size_t> next_shard = 0;
+    static thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARD_COUNT;
+    return shard;
+}
+
+uint64_t Counter::Get() const {
+    uint64_t value = 0;
+    for (const Shard& shard : shards_) {
+        value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+uint64_t LatencyHistogram::Snapshot::GetPercentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    //Ближайший ранг, как в tools/benchmark
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return GetBucketUpperBound(static_cast<int>(bucket));
+        }
+    }
+    return GetBucketUpperBound(BUCKET_COUNT - 1);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+    Snapshot snapshot;
+    snapshot.buckets.assign(BUCKET_COUNT, 0);
+    for (const Shard& shard : shards_) {
+        for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            snapshot.buckets[bucket] += shard.buckets[bucket].load(std::memory_order_relaxed);
+        }
+        snapshot.sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+    }
+    //Счётчики корзин и сумма читаются не одновременно, поэтому число замеров считается по корзинам
+    for (const uint64_t bucket_count : snapshot.buckets) {
+        snapshot.count += bucket_count;
+    }
+    return snapshot;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(int bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const int exponent = bucket / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+    const uint64_t sub_bucket = bucket % SUB_BUCKET_COUNT;
+    const uint64_t lower_bound = (SUB_BUCKET_COUNT + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+    return lower_bound + ((uint64_t{1} << (exponent - SUB_BUCKET_BITS)) - 1);
+}
+
+Counter& MetricsRegistry::GetCounter(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    return GetOrCreate(counters_, name);
+}
+
+Gauge& MetricsRegistry::GetGauge(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    return GetOrCreate(gauges_, name);
+}
+
+LatencyHistogram& MetricsRegistry::GetHistogram(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    return GetOrCreate(histograms_, name);
+}
+
+void MetricsRegistry::DumpText(std::ostream& out) const {
+    using namespace std::literals;
+    std::lock_guard guard(mutex_);
+    for (const auto& [name, counter] : counters_) {
+        out << name << ' ' << counter->Get() << '\n';
+    }
+    for (const auto& [name, gauge] : gauges_) {
+        out << name << ' ' << gauge->Get() << '\n';
+    }
+    for (const auto& [name, histogram] : histograms_) {
+        out << name << ' ';
+        WriteHistogramFields(out, histogram->GetSnapshot(), " "sv, ""sv);
+        out << '\n';
+    }
+}
+
+void MetricsRegistry::DumpJson(std::ostream& out) const {
+    using namespace std::literals;
+    std::lock_guard guard(mutex_);
+    //Имена метрик задаёт код сервера, экранирование не требуется
+    const auto write_values = [&out](const auto& metrics) {
+        bool is_first = true;
+        for (const auto& [name, metric] : metrics) {
+            out << (is_first ? ""sv : ", "sv) << '"' << name << "\": "sv << metric->Get();
+            is_first = false;
+        }
+    };
+    out << "{\"counters\": {"sv;
+    write_values(counters_);
+    out << "}, \"gauges\": {"sv;
+    write_values(gauges_);
+    out << "}, \"histograms\": {"sv;
+    bool is_first = true;
+    for (const auto& [name, histogram] : histograms_) {
+        out << (is_first ? ""sv : ", "sv) << '"' << name << "\": {"sv;
+        WriteHistogramFields(out, histogram->GetSnapshot(), ": "sv, "\""sv);
+        out << '}';
+        is_first = false;
+    }
+    out << "}}\n"sv;
+}
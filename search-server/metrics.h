@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Число копий каждой метрики. Поток пишет в свою копию, чтобы потоки не делили строки кеша, чтение складывает копии
+const int METRICS_SHARD_COUNT = 16;
+
+//Номер копии метрик для текущего потока, назначается при первом обращении по кругу
+size_t GetMetricsShard();
+
+class Counter {
+public:
+    void Add(uint64_t value = 1) {
+        shards_[GetMetricsShard()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+    uint64_t Get() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value = 0;
+    };
+    std::array<Shard, METRICS_SHARD_COUNT> shards_;
+};
+
+class Gauge {
+public:
+    void Set(int64_t value) {
+        value_.store(value, std::memory_order_relaxed);
+    }
+    int64_t Get() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> value_ = 0;
+};
+
+//Гистограмма задержек в наносекундах. Корзины логарифмические: каждая степень двойки делится на SUB_BUCKET_COUNT
+//равных частей, поэтому перцентиль завышается не больше чем на 1 / SUB_BUCKET_COUNT
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    void Record(int64_t latency_ns) {
+        const uint64_t value = latency_ns > 0 ? static_cast<uint64_t>(latency_ns) : 0;
+        Shard& shard = shards_[GetMetricsShard()];
+        shard.buckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum_ns.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+        std::vector<uint64_t> buckets;
+
+        //Верхняя граница корзины, в которую попал перцентиль, 0 для пустой гистограммы
+        uint64_t GetPercentile(double fraction) const;
+    };
+    Snapshot GetSnapshot() const;
+
+    static int GetBucket(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<int>(value);
+        }
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        const int exponent = static_cast<int>(index);
+#else
+        const int exponent = 63 - __builtin_clzll(value);
+#endif
+        const int sub_bucket = static_cast<int>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+    }
+    static uint64_t GetBucketUpperBound(int bucket);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets = {};
+        std::atomic<uint64_t> sum_ns = 0;
+    };
+    std::array<Shard, METRICS_SHARD_COUNT> shards_;
+};
+
+//Именованные метрики. Регистрация берёт мьютекс, поэтому ссылки на метрики получают заранее и хранят:
+//запись в метрику по ссылке не блокируется. Метрики живут, пока живёт реестр
+class MetricsRegistry {
+public:
+    Counter& GetCounter(std::string_view name);
+    Gauge& GetGauge(std::string_view name);
+    LatencyHistogram& GetHistogram(std::string_view name);
+
+    //Строка на метрику: имя и значение, для гистограмм - число замеров, среднее, p50, p99, p999 и максимум в нс
+    void DumpText(std::ostream& out) const;
+    void DumpJson(std::ostream& out) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Counter>, std::less<>> counters_;
+    std::map<std::string, std::unique_ptr<Gauge>, std::less<>> gauges_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>, std::less<>> histograms_;
+};
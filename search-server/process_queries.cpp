@@ -1,26 +1,27 @@
 #include "process_queries.h"
 
 
+SearchServer::BatchResult ProcessQueriesBatch(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
+
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    //RequestQueue queue(search_server);
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& str) {
-        return search_server.FindTopDocuments(str);
-    });
+    const auto batch = ProcessQueriesBatch(search_server, queries);
+    std::vector<std::vector<Document>> result;
+    result.reserve(batch.size());
+    for(size_t i = 0; i < batch.size(); ++i) {
+        result.emplace_back(batch[i].begin(), batch[i].end());
+    }
     return result;
 }
 
 std::list<Document> ProcessQueriesJoined(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    std::list<Document> result;
-    auto temp = ProcessQueries(search_server, queries);
-    for(const auto& vect : temp) {
-        for(const Document& doc : vect) {
-            result.push_back(doc);
-        }
-    }
-    return result;
+    const auto batch = ProcessQueriesBatch(search_server, queries);
+    return std::list<Document>(batch.documents.begin(), batch.documents.end());
 }
\ No newline at end of file
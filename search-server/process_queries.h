@@ -9,6 +9,11 @@
 #include <algorithm>
 #include <list>
 
+//Выдачи всех запросов в одном буфере, запросы выполняются общим проходом по индексу
+SearchServer::BatchResult ProcessQueriesBatch(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
+
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries);
@@ -0,0 +1,88 @@
+#include "query_cache.h"
+
+#include <functional>
+
+namespace {
+
+//Приблизительный объём записи вместе с узлами списка и хеш-таблицы
+size_t GetEntryBytes(std::string_view key, const std::vector<Document>& documents) {
+    const size_t node_overhead = 4 * sizeof(void*);
+    return 2 * node_overhead + sizeof(std::string) + key.size() + sizeof(std::vector<Document>) + documents.size() * sizeof(Document);
+}
+
+}
+
+QueryCache::QueryCache(size_t max_bytes)
+    : max_segment_bytes_(max_bytes / SEGMENT_COUNT) {
+}
+
+bool QueryCache::Find(std::string_view key, uint64_t generation, std::vector<Document>& result) {
+    Segment& segment = GetSegment(key);
+    std::lock_guard lock(segment.mutex);
+    const auto it = segment.entry_by_key.find(key);
+    if (it == segment.entry_by_key.end()) {
+        ++misses_;
+        return false;
+    }
+    if (it->second->generation != generation) {
+        Erase(segment, it->second);
+        ++evictions_;
+        ++misses_;
+        return false;
+    }
+    segment.entries.splice(segment.entries.begin(), segment.entries, it->second);
+    result = it->second->documents;
+    ++hits_;
+    return true;
+}
+
+void QueryCache::Insert(std::string_view key, uint64_t generation, const std::vector<Document>& documents) {
+    const size_t bytes = GetEntryBytes(key, documents);
+    if (bytes > max_segment_bytes_) {
+        return;
+    }
+    Segment& segment = GetSegment(key);
+    std::lock_guard lock(segment.mutex);
+    if (const auto it = segment.entry_by_key.find(key); it != segment.entry_by_key.end()) {
+        Erase(segment, it->second);
+    }
+    while (segment.bytes + bytes > max_segment_bytes_) {
+        Erase(segment, std::prev(segment.entries.end()));
+        ++evictions_;
+    }
+    segment.entries.push_front({std::string(key), generation, documents, bytes});
+    segment.entry_by_key.emplace(segment.entries.front().key, segment.entries.begin());
+    segment.bytes += bytes;
+}
+
+void QueryCache::Clear() {
+    for (Segment& segment : segments_) {
+        std::lock_guard lock(segment.mutex);
+        segment.entry_by_key.clear();
+        segment.entries.clear();
+        segment.bytes = 0;
+    }
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    for (const Segment& segment : segments_) {
+        std::lock_guard lock(segment.mutex);
+        stats.entry_count += segment.entries.size();
+        stats.bytes += segment.bytes;
+    }
+    return stats;
+}
+
+QueryCache::Segment& QueryCache::GetSegment(std::string_view key) {
+    return segments_[std::hash<std::string_view>{}(key) % SEGMENT_COUNT];
+}
+
+void QueryCache::Erase(Segment& segment, std::list<Entry>::iterator entry) {
+    segment.bytes -= entry->bytes;
+    segment.entry_by_key.erase(entry->key);
+    segment.entries.erase(entry);
+}
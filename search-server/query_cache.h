@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+//Потокобезопасный кеш выдачи по ключу запроса. Запись помнит поколение индекса, при котором посчитана,
+//и при другом поколении считается устаревшей. Объём ограничен в байтах, при переполнении вытесняются
+//давно не использованные записи. Ключи распределены по сегментам с отдельными блокировками
+class QueryCache {
+public:
+    explicit QueryCache(size_t max_bytes);
+
+    //Копирует выдачу в result, если запись есть и посчитана при поколении generation
+    bool Find(std::string_view key, uint64_t generation, std::vector<Document>& result);
+    void Insert(std::string_view key, uint64_t generation, const std::vector<Document>& documents);
+    void Clear();
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0; //Вытесненные по объёму и устаревшие записи
+        size_t entry_count = 0;
+        size_t bytes = 0;
+    };
+    Stats GetStats() const;
+
+private:
+    static constexpr size_t SEGMENT_COUNT = 16;
+
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+        size_t bytes;
+    };
+    struct Segment {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; //От недавно использованных к давно не использованным
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> entry_by_key; //Ключи - view на Entry::key
+        size_t bytes = 0;
+    };
+
+    size_t max_segment_bytes_;
+    std::array<Segment, SEGMENT_COUNT> segments_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+
+    Segment& GetSegment(std::string_view key);
+    //Вызывается под блокировкой сегмента
+    void Erase(Segment& segment, std::list<Entry>::iterator entry);
+};
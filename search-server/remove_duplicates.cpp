@@ -1,22 +1,149 @@
 #include "remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::set<int> duplicates;
-    std::set<std::set<std::string_view>> words_to_documents;
-    for(int document_id : search_server) {
-        std::set<std::string_view> words;
-        for(const auto& [word, stats] : search_server.GetWordFrequencies(document_id)) {
-            words.insert(word);
-        }
-        if(words_to_documents.count(words) == 0) {
-            words_to_documents.insert(words);
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "splitmix.h"
+
+namespace {
+
+double ComputeJaccard(const std::vector<int>& lhs, const std::vector<int>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1;
+    }
+    size_t common = 0;
+    for (auto left = lhs.begin(), right = rhs.begin(); left != lhs.end() && right != rhs.end();) {
+        if (*left < *right) {
+            ++left;
+        } else if (*right < *left) {
+            ++right;
         } else {
-            duplicates.insert(document_id);
+            ++common;
+            ++left;
+            ++right;
         }
     }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
+
+void RemoveAndReport(SearchServer& search_server, const std::vector<int>& duplicates) {
     for(int id : duplicates) {
         using namespace std::literals;
         std::cout << "Found duplicate document id "s << id << std::endl;
-        search_server.RemoveDocument(id);
     }
+    search_server.RemoveDocuments(duplicates);
+}
+
+}
+
+//Отпечатки считаются параллельно, затем документы сортируются по отпечатку и id: в группе с одним отпечатком
+//первым идёт документ с меньшим id. Совпадение отпечатков перепроверяется сравнением слов
+std::vector<int> FindDuplicates(const SearchServer& search_server) {
+    struct Fingerprint {
+        uint64_t value;
+        int document_id;
+    };
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<Fingerprint> fingerprints(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(), [&search_server](int document_id) {
+        return Fingerprint{search_server.GetTermSetFingerprint(document_id), document_id};
+    });
+    std::sort(std::execution::par, fingerprints.begin(), fingerprints.end(), [](const Fingerprint& lhs, const Fingerprint& rhs) {
+        return lhs.value != rhs.value ? lhs.value < rhs.value : lhs.document_id < rhs.document_id;
+    });
+    std::vector<int> duplicates;
+    for (size_t group_begin = 0; group_begin < fingerprints.size();) {
+        size_t group_end = group_begin + 1;
+        while (group_end < fingerprints.size() && fingerprints[group_end].value == fingerprints[group_begin].value) {
+            ++group_end;
+        }
+        //Оригиналы группы: почти всегда один, больше - только при коллизии отпечатков
+        std::vector<int> originals = {fingerprints[group_begin].document_id};
+        for (size_t i = group_begin + 1; i < group_end; ++i) {
+            const int document_id = fingerprints[i].document_id;
+            const auto& term_ids = search_server.GetDocumentTermIds(document_id);
+            const bool is_duplicate = std::any_of(originals.begin(), originals.end(), [&](int original_id) {
+                return search_server.GetDocumentTermIds(original_id) == term_ids;
+            });
+            if (is_duplicate) {
+                duplicates.push_back(document_id);
+            } else {
+                originals.push_back(document_id);
+            }
+        }
+        group_begin = group_end;
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+//Сигнатуры считаются параллельно. Затем документы просматриваются по возрастанию id: документ - дубликат,
+//если среди оставленных документов с общей полосой есть достаточно похожий, иначе он оставляется
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options) {
+    using namespace std::literals;
+    if (options.band_count <= 0 || options.rows_per_band <= 0 || !(options.jaccard_threshold > 0 && options.jaccard_threshold <= 1)) {
+        throw std::invalid_argument("Invalid near duplicate options"s);
+    }
+    const int signature_size = options.band_count * options.rows_per_band;
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<uint64_t> band_hashes(document_ids.size() * options.band_count);
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        const auto& term_ids = search_server.GetDocumentTermIds(document_ids[index]);
+        std::vector<uint64_t> signature(signature_size, std::numeric_limits<uint64_t>::max());
+        for (const int term_id : term_ids) {
+            const uint64_t term_hash = SplitMix64(static_cast<uint32_t>(term_id));
+            for (int i = 0; i < signature_size; ++i) {
+                signature[i] = std::min(signature[i], SplitMix64(term_hash + 0x9E3779B97F4A7C15ull * (i + 1)));
+            }
+        }
+        for (int band = 0; band < options.band_count; ++band) {
+            uint64_t band_hash = band;
+            for (int row = 0; row < options.rows_per_band; ++row) {
+                band_hash = SplitMix64(band_hash ^ signature[band * options.rows_per_band + row]);
+            }
+            band_hashes[index * options.band_count + band] = band_hash;
+        }
+    });
+
+    std::unordered_map<uint64_t, std::vector<int>> buckets; //{ хеш полосы, оставленные документы }
+    std::vector<int> duplicates;
+    std::vector<int> candidates;
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        const auto& term_ids = search_server.GetDocumentTermIds(document_ids[index]);
+        candidates.clear();
+        for (int band = 0; band < options.band_count; ++band) {
+            //Номер полосы входит в хеш, поэтому у разных полос общая таблица
+            const auto it = buckets.find(band_hashes[index * options.band_count + band]);
+            if (it != buckets.end()) {
+                candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        const bool is_duplicate = std::any_of(candidates.begin(), candidates.end(), [&](int original_id) {
+            return ComputeJaccard(search_server.GetDocumentTermIds(original_id), term_ids) >= options.jaccard_threshold;
+        });
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[index]);
+            continue;
+        }
+        for (int band = 0; band < options.band_count; ++band) {
+            buckets[band_hashes[index * options.band_count + band]].push_back(document_ids[index]);
+        }
+    }
+    return duplicates;
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    RemoveAndReport(search_server, FindDuplicates(search_server));
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options) {
+    RemoveAndReport(search_server, FindNearDuplicates(search_server, options));
 }
@@ -6,6 +6,22 @@
 #include <set>
 #include <map>
 #include <string>
+#include <vector>
 
+//Параметры поиска почти-дубликатов. Сигнатура MinHash из band_count * rows_per_band значений делится на полосы,
+//документы с совпавшей полосой - кандидаты, у кандидатов считается точный коэффициент Жаккара множеств слов.
+//Пара с коэффициентом s становится кандидатом с вероятностью 1 - (1 - s^rows_per_band)^band_count
+struct NearDuplicateOptions {
+    double jaccard_threshold = 0.9;
+    int band_count = 16;
+    int rows_per_band = 4;
+};
 
+//Документы, множество слов которых совпадает с множеством слов документа с меньшим id, по возрастанию id
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+//Документы, похожие по Жаккару не меньше порога на оставленный документ с меньшим id, по возрастанию id
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options = {});
+
+//Удаляют найденные дубликаты одним пакетом и печатают их id
 void RemoveDuplicates(SearchServer& search_server);
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options = {});
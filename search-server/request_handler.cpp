@@ -0,0 +1,156 @@
+#include "request_handler.h"
+
+#include <charconv>
+#include <mutex>
+#include <sstream>
+
+namespace {
+
+//Отрезает от text первое поле до пробела
+std::string_view TakeField(std::string_view& text) {
+    const size_t space = text.find(' ');
+    const std::string_view field = text.substr(0, space);
+    text.remove_prefix(space == std::string_view::npos ? text.size() : space + 1);
+    return field;
+}
+
+int TakeInt(std::string_view& text) {
+    using std::literals::string_literals::operator""s;
+    const std::string_view field = TakeField(text);
+    int value = 0;
+    const auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (field.empty() || error != std::errc() || end != field.data() + field.size()) {
+        throw std::invalid_argument("Field "s + std::string(field) + " is not a number"s);
+    }
+    return value;
+}
+
+template <typename Number>
+void AppendNumber(std::string& response, Number value) {
+    char buffer[32];
+    const auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    response.push_back(' ');
+    response.append(buffer, end);
+}
+
+}
+
+RequestHandler::RequestHandler(SearchServer& search_server, MetricsRegistry* metrics)
+    : server_(search_server)
+    , metrics_(metrics) {
+    using std::literals::string_view_literals::operator""sv;
+    if (metrics_ != nullptr) {
+        request_latency_ = &metrics_->GetHistogram("request_handler.request_ns"sv);
+    }
+}
+
+void RequestHandler::Handle(std::string_view request, std::string& response) {
+    using std::literals::string_view_literals::operator""sv;
+    const auto latency = MeasureLatency(request_latency_);
+    response.clear();
+    if (!request.empty() && request.back() == '\r') {
+        request.remove_suffix(1);
+    }
+    try {
+        const std::string_view command = TakeField(request);
+        if (command == "FIND"sv) {
+            HandleFind(request, response);
+        } else if (command == "MATCH"sv) {
+            HandleMatch(request, response);
+        } else if (command == "ADD"sv) {
+            HandleAdd(request, response);
+        } else if (command == "REMOVE"sv) {
+            HandleRemove(request, response);
+        } else if (command == "COUNT"sv) {
+            HandleCount(response);
+        } else if (command == "METRICS"sv) {
+            HandleMetrics(response);
+        } else {
+            response = "ERR unknown command"sv;
+        }
+    } catch (const std::exception& e) {
+        response = "ERR "sv;
+        response += e.what();
+    }
+}
+
+void RequestHandler::HandleFind(std::string_view arguments, std::string& response) {
+    using std::literals::string_view_literals::operator""sv;
+    const int top_count = TakeInt(arguments);
+    std::shared_lock lock(mutex_);
+    const std::vector<Document> documents = server_.FindTopDocuments(arguments, top_count);
+    lock.unlock();
+    response = "OK"sv;
+    AppendNumber(response, documents.size());
+    for (const Document& document : documents) {
+        AppendNumber(response, document.id);
+        AppendNumber(response, document.relevance);
+        AppendNumber(response, document.rating);
+    }
+}
+
+void RequestHandler::HandleMatch(std::string_view arguments, std::string& response) {
+    using std::literals::string_view_literals::operator""sv;
+    const int document_id = TakeInt(arguments);
+    //Слова результата ссылаются на словарь индекса, поэтому ответ собирается под блокировкой
+    std::shared_lock lock(mutex_);
+    const auto [words, status] = server_.MatchDocument(arguments, document_id);
+    response = "OK"sv;
+    AppendNumber(response, static_cast<int>(status));
+    for (const std::string_view word : words) {
+        response.push_back(' ');
+        response += word;
+    }
+}
+
+void RequestHandler::HandleAdd(std::string_view arguments, std::string& response) {
+    using std::literals::string_literals::operator""s;
+    using std::literals::string_view_literals::operator""sv;
+    const int document_id = TakeInt(arguments);
+    const int status = TakeInt(arguments);
+    if (status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("Invalid document status"s);
+    }
+    const int rating_count = TakeInt(arguments);
+    if (rating_count < 0) {
+        throw std::invalid_argument("Invalid rating count"s);
+    }
+    std::vector<int> ratings;
+    for (int i = 0; i < rating_count; ++i) {
+        ratings.push_back(TakeInt(arguments));
+    }
+    std::unique_lock lock(mutex_);
+    server_.AddDocument(document_id, arguments, static_cast<DocumentStatus>(status), ratings);
+    response = "OK"sv;
+}
+
+void RequestHandler::HandleRemove(std::string_view arguments, std::string& response) {
+    using std::literals::string_view_literals::operator""sv;
+    const int document_id = TakeInt(arguments);
+    std::unique_lock lock(mutex_);
+    server_.RemoveDocument(document_id);
+    response = "OK"sv;
+}
+
+void RequestHandler::HandleCount(std::string& response) {
+    using std::literals::string_view_literals::operator""sv;
+    std::shared_lock lock(mutex_);
+    const int document_count = server_.GetDocumentCount();
+    lock.unlock();
+    response = "OK"sv;
+    AppendNumber(response, document_count);
+}
+
+void RequestHandler::HandleMetrics(std::string& response) {
+    using std::literals::string_view_literals::operator""sv;
+    if (metrics_ == nullptr) {
+        response = "ERR metrics are disabled"sv;
+        return;
+    }
+    std::ostringstream out;
+    metrics_->DumpJson(out);
+    std::string json = out.str();
+    json.pop_back(); //Ответ - одна строка без '\n'
+    response = "OK "sv;
+    response += json;
+}
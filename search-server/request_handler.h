@@ -0,0 +1,39 @@
+#pragma once
+
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+#include "metrics.h"
+#include "search_server.h"
+
+//Текстовый протокол сетевого сервера: запрос и ответ - строки, поля разделены пробелами, текст - до конца строки.
+//  FIND <top_count> <query>                             -> OK <count> {<id> <relevance> <rating>}
+//  MATCH <id> <query>                                   -> OK <status> {<word>}
+//  ADD <id> <status> <rating_count> {<rating>} <text>   -> OK
+//  REMOVE <id>                                          -> OK
+//  COUNT                                                -> OK <document_count>
+//  METRICS                                              -> OK <JSON из MetricsRegistry::DumpJson>
+//Статус - номер значения DocumentStatus. При ошибке ответ ERR <сообщение>
+class RequestHandler {
+public:
+    //metrics - реестр для METRICS и задержки запросов request_handler.request_ns, nullptr отключает учёт
+    explicit RequestHandler(SearchServer& search_server, MetricsRegistry* metrics = nullptr);
+
+    //Можно вызывать из нескольких потоков: поиск выполняется параллельно, изменения индекса - по одному.
+    //response перезаписывается без '\n' на конце, его память переиспользуется между вызовами
+    void Handle(std::string_view request, std::string& response);
+
+private:
+    SearchServer& server_;
+    std::shared_mutex mutex_;
+    MetricsRegistry* metrics_;
+    LatencyHistogram* request_latency_ = nullptr;
+
+    void HandleFind(std::string_view arguments, std::string& response);
+    void HandleMatch(std::string_view arguments, std::string& response);
+    void HandleAdd(std::string_view arguments, std::string& response);
+    void HandleRemove(std::string_view arguments, std::string& response);
+    void HandleCount(std::string& response);
+    void HandleMetrics(std::string& response);
+};
@@ -1,9 +1,23 @@
     #include "request_queue.h"
 
     std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-            return RequestQueue::AddFindRequest(raw_query, [status](int, DocumentStatus status_filter, int) {
-                return status_filter == status;
-            });
+            server_.NormalizeQuery(raw_query, cache_key_);
+            const size_t query_size = cache_key_.size();
+            cache_key_.push_back(static_cast<char>('0' + static_cast<int>(status)));
+            std::vector<Document> result;
+            const uint64_t generation = server_.GetGeneration();
+            if (!cache_.Find(cache_key_, generation, result)) {
+                //Ищем по канонической записи, чтобы все запросы с одним ключом получали одну и ту же выдачу
+                result = server_.FindTopDocuments(std::string_view(cache_key_).substr(0, query_size), status);
+                cache_.Insert(cache_key_, generation, result);
+                if (cache_misses_ != nullptr) {
+                    cache_misses_->Add();
+                }
+            } else if (cache_hits_ != nullptr) {
+                cache_hits_->Add();
+            }
+            AddResult(result);
+            return result;
     }
 
         std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
@@ -16,3 +30,27 @@
             });
         }
 
+        QueryCache::Stats RequestQueue::GetCacheStats() const {
+            return cache_.GetStats();
+        }
+
+        void RequestQueue::SetMetrics(MetricsRegistry* metrics, std::string_view prefix) {
+            if (metrics == nullptr) {
+                cache_hits_ = cache_misses_ = empty_results_ = nullptr;
+                return;
+            }
+            const std::string base = std::string(prefix) + '.';
+            cache_hits_ = &metrics->GetCounter(base + "cache_hits");
+            cache_misses_ = &metrics->GetCounter(base + "cache_misses");
+            empty_results_ = &metrics->GetCounter(base + "empty_results");
+        }
+
+        void RequestQueue::AddResult(const std::vector<Document>& result) {
+            if (empty_results_ != nullptr && result.empty()) {
+                empty_results_->Add();
+            }
+            if(requests_.size() >= min_in_day_) {
+                requests_.pop_front();
+            }
+            requests_.push_back({result.size()});
+        }
@@ -6,12 +6,19 @@
 #include <utility>
 
 #include "document.h"
+#include "metrics.h"
+#include "query_cache.h"
 #include "search_server.h"
 
+const size_t DEFAULT_QUERY_CACHE_BYTES = 16 << 20;
+
+//Запросы по статусу выполняются и кешируются в канонической записи SearchServer::NormalizeQuery, поэтому повторы слов
+//в запросе не учитываются дважды. Запросы с предикатом не кешируются. cache_bytes = 0 отключает кеш
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server) 
-    : server_(search_server) {
+    explicit RequestQueue(const SearchServer& search_server, size_t cache_bytes = DEFAULT_QUERY_CACHE_BYTES)
+    : server_(search_server)
+    , cache_(cache_bytes) {
     }
 
     template <typename DocumentPredicate>
@@ -20,6 +27,9 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
     int GetNoResultRequests() const;
+    QueryCache::Stats GetCacheStats() const;
+    //Счётчики prefix.cache_hits, prefix.cache_misses и prefix.empty_results в реестре, nullptr отключает учёт
+    void SetMetrics(MetricsRegistry* metrics, std::string_view prefix = "request_queue");
 private:
     const SearchServer& server_;
     struct QueryResult {
@@ -27,6 +37,13 @@ private:
     };
     std::deque<QueryResult> requests_;
     const static int min_in_day_ = 1440;
+    QueryCache cache_;
+    std::string cache_key_;
+    Counter* cache_hits_ = nullptr;
+    Counter* cache_misses_ = nullptr;
+    Counter* empty_results_ = nullptr;
+
+    void AddResult(const std::vector<Document>& result);
 }; 
 
 //Решил вынести реализацию за класс (как в рекомендациях в search_server.h) и использовать шаблонный метод для реализации,
@@ -34,9 +51,6 @@ private:
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
     std::vector<Document> result = server_.FindTopDocuments(raw_query, document_predicate);
-    if(requests_.size() >= min_in_day_) {
-        requests_.pop_front();
-    }
-    requests_.push_back({result.size()});
+    AddResult(result);
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+//Плотный массив релевантностей для диапазона документов [base, base + size).
+//Хранит список затронутых ячеек, чтобы сбрасываться за O(затронутых), а не за O(size).
+//Используется одним потоком, поэтому блокировок нет
+class ScoreAccumulator {
+public:
+    //Готовит аккумулятор к работе с новым диапазоном. Предыдущий запрос должен быть завершён вызовом Clear()
+    void Prepare(int base, int size);
+
+    //true, если документ ещё не встречался (не оценён и не исключён)
+    bool IsFresh(int ordinal) const;
+    bool IsExcluded(int ordinal) const;
+
+    void Add(int ordinal, double value);
+    void Exclude(int ordinal);
+    //Исключение минус-словом помечается отдельно, чтобы при обходе плюс-слов посчитать такие документы
+    void ExcludeByMinusWord(int ordinal);
+    //true при первой встрече плюс-словом документа, исключённого минус-словом. После неё документ
+    //исключён как обычно, поэтому каждый такой кандидат считается один раз
+    bool TakeMinusExcluded(int ordinal);
+
+    //Упорядочивает обход ForEachScored по возрастанию номеров документов
+    void SortTouched();
+
+    //Вызывает func(ordinal, relevance) для каждого оценённого и не исключённого документа
+    template <typename Func>
+    void ForEachScored(Func func) const;
+
+    void Clear();
+
+private:
+    enum class SlotState : char {
+        FRESH,
+        SCORED,
+        EXCLUDED,
+        MINUS_EXCLUDED,
+    };
+
+    int base_ = 0;
+    std::vector<double> scores_;
+    std::vector<SlotState> states_;
+    std::vector<int> touched_;
+};
+
+inline void ScoreAccumulator::Prepare(int base, int size) {
+    base_ = base;
+    if (static_cast<int>(scores_.size()) < size) {
+        scores_.resize(size, 0.0);
+        states_.resize(size, SlotState::FRESH);
+    }
+}
+
+inline bool ScoreAccumulator::IsFresh(int ordinal) const {
+    return states_[ordinal - base_] == SlotState::FRESH;
+}
+
+inline bool ScoreAccumulator::IsExcluded(int ordinal) const {
+    const SlotState state = states_[ordinal - base_];
+    return state == SlotState::EXCLUDED || state == SlotState::MINUS_EXCLUDED;
+}
+
+inline void ScoreAccumulator::Add(int ordinal, double value) {
+    const int slot = ordinal - base_;
+    if (states_[slot] == SlotState::FRESH) {
+        states_[slot] = SlotState::SCORED;
+        touched_.push_back(slot);
+    }
+    scores_[slot] += value;
+}
+
+inline void ScoreAccumulator::Exclude(int ordinal) {
+    const int slot = ordinal - base_;
+    if (states_[slot] == SlotState::FRESH) {
+        touched_.push_back(slot);
+    }
+    states_[slot] = SlotState::EXCLUDED;
+}
+
+inline void ScoreAccumulator::ExcludeByMinusWord(int ordinal) {
+    const int slot = ordinal - base_;
+    if (states_[slot] == SlotState::FRESH) {
+        touched_.push_back(slot);
+        states_[slot] = SlotState::MINUS_EXCLUDED;
+    }
+}
+
+inline bool ScoreAccumulator::TakeMinusExcluded(int ordinal) {
+    const int slot = ordinal - base_;
+    if (states_[slot] != SlotState::MINUS_EXCLUDED) {
+        return false;
+    }
+    states_[slot] = SlotState::EXCLUDED;
+    return true;
+}
+
+inline void ScoreAccumulator::SortTouched() {
+    std::sort(touched_.begin(), touched_.end());
+}
+
+template <typename Func>
+void ScoreAccumulator::ForEachScored(Func func) const {
+    for (const int slot : touched_) {
+        if (states_[slot] == SlotState::SCORED) {
+            func(base_ + slot, scores_[slot]);
+        }
+    }
+}
+
+inline void ScoreAccumulator::Clear() {
+    for (const int slot : touched_) {
+        scores_[slot] = 0.0;
+        states_[slot] = SlotState::FRESH;
+    }
+    touched_.clear();
+}
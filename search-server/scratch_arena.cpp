@@ -0,0 +1,57 @@
+#include "scratch_arena.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+const size_t INITIAL_ARENA_SIZE = 4096;
+
+}
+
+ScratchArena::ScratchArena() {
+    struct Pool {
+        std::vector<std::unique_ptr<Level>> levels;
+        size_t depth = 0;
+    };
+    static thread_local Pool pool;
+    if (pool.depth == pool.levels.size()) {
+        auto level = std::make_unique<Level>();
+        level->buffer.resize(INITIAL_ARENA_SIZE);
+        pool.levels.push_back(std::move(level));
+    }
+    level_ = pool.levels[pool.depth++].get();
+    depth_ = &pool.depth;
+    level_->resource.emplace(level_->buffer.data(), level_->buffer.size(), &level_->upstream);
+}
+
+ScratchArena::~ScratchArena() {
+    level_->resource.reset();
+    if (level_->upstream.overflow_bytes > 0) {
+        //Запас вдвое, чтобы запросы, растущие понемногу, не увеличивали буфер каждый раз
+        level_->buffer.resize(std::max(level_->buffer.size(), level_->upstream.overflow_bytes) * 2);
+        level_->upstream.overflow_bytes = 0;
+    }
+    --*depth_;
+}
+
+std::pmr::memory_resource* ScratchArena::GetResource() const {
+    return &*level_->resource;
+}
+
+size_t ScratchArena::GetCapacity() const {
+    return level_->buffer.size();
+}
+
+void* ScratchArena::UpstreamResource::do_allocate(size_t bytes, size_t alignment) {
+    overflow_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void ScratchArena::UpstreamResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+}
+
+bool ScratchArena::UpstreamResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
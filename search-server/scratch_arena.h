@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+//Монотонная арена для временной памяти запроса. Память берётся из буфера текущего потока и целиком
+//возвращается при уничтожении арены, без вызовов глобального аллокатора. Если буфера не хватило,
+//недостающее берётся у new/delete, а буфер увеличивается к следующему запросу.
+//Вложенный запрос в том же потоке получает следующий буфер из пула, как ScratchQuery.
+//Ресурс не потокобезопасен: выделять память из него может только поток, создавший арену
+class ScratchArena {
+public:
+    ScratchArena();
+    ~ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    std::pmr::memory_resource* GetResource() const;
+    //Размер буфера арены, для тестов
+    size_t GetCapacity() const;
+
+private:
+    //Передаёт выделения new/delete и считает байты, взятые сверх буфера
+    class UpstreamResource : public std::pmr::memory_resource {
+    public:
+        size_t overflow_bytes = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    struct Level {
+        std::vector<std::byte> buffer;
+        UpstreamResource upstream;
+        std::optional<std::pmr::monotonic_buffer_resource> resource;
+    };
+
+    Level* level_;
+    size_t* depth_;
+};
@@ -1,46 +1,520 @@
 #include "search_server.h"
 
-#include <list>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "snapshot.h"
+#include "splitmix.h"
+
+namespace {
+
+//Шаг splitmix64: добавляет value к отпечатку и перемешивает биты
+uint64_t MixFingerprint(uint64_t fingerprint, uint64_t value) {
+    return SplitMix64(fingerprint + value + 0x9E3779B97F4A7C15ull);
+}
+
+}
 
 SearchServer::SearchServer(const std::string& stop_words_text)
         : SearchServer(SplitIntoWords(stop_words_text))
 {
 }
 SearchServer::SearchServer(std::string_view stop_words_text)
-        : SearchServer(SplitIntoWords(std::string(stop_words_text)))
+        : SearchServer(SplitIntoWords(stop_words_text))
 {
 }
 
+SearchServer::SearchServer(SnapshotReader& reader)
+        : stop_words_(ReadStopWords(reader))
+{
+    const size_t ordinal_bound = index_.Load(reader);
+    const size_t term_count = index_.GetTermCount();
+    std::vector<int32_t> ids;
+    std::vector<int32_t> ratings;
+    std::vector<int32_t> statuses;
+    std::vector<uint8_t> removed;
+    std::vector<uint64_t> forward_offsets;
+    std::vector<int32_t> forward_term_ids;
+    std::vector<double> forward_term_freqs;
+    reader.ReadArray(ids);
+    reader.ReadArray(ratings);
+    reader.ReadArray(statuses);
+    reader.ReadArray(removed);
+    reader.ReadArray(forward_offsets);
+    reader.ReadArray(forward_term_ids);
+    reader.ReadArray(forward_term_freqs);
+    posting_count_ = reader.ReadValue<uint64_t>();
+    dead_posting_count_ = reader.ReadValue<uint64_t>();
+    const size_t document_count = ids.size();
+    if (ratings.size() != document_count || statuses.size() != document_count || removed.size() != document_count
+        || forward_offsets.size() != document_count + 1 || forward_offsets.back() != forward_term_ids.size()
+        || forward_term_freqs.size() != forward_term_ids.size() || ordinal_bound > document_count) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+    for (const int32_t term_id : forward_term_ids) {
+        if (term_id < 0 || static_cast<size_t>(term_id) >= term_count) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+    }
+
+    documents_.reserve(document_count);
+    std::vector<std::pair<int, int>> live_ordinals; //{ Ид документа, ordinal }
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        const uint64_t begin = forward_offsets[ordinal];
+        const uint64_t end = forward_offsets[ordinal + 1];
+        if (begin > end || end > forward_term_ids.size() || statuses[ordinal] < static_cast<int32_t>(DocumentStatus::ACTUAL)
+            || statuses[ordinal] > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        documents_.push_back({ids[ordinal], ratings[ordinal], static_cast<DocumentStatus>(statuses[ordinal]),
+                              std::vector<int>(forward_term_ids.begin() + begin, forward_term_ids.begin() + end),
+                              std::vector<double>(forward_term_freqs.begin() + begin, forward_term_freqs.begin() + end),
+                              removed[ordinal] != 0});
+        if (!removed[ordinal]) {
+            live_ordinals.emplace_back(ids[ordinal], static_cast<int>(ordinal));
+        }
+    }
+    std::sort(live_ordinals.begin(), live_ordinals.end());
+    const auto duplicate = std::adjacent_find(live_ordinals.begin(), live_ordinals.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    });
+    if (duplicate != live_ordinals.end()) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+    for (const auto& [document_id, ordinal] : live_ordinals) {
+        document_ordinals_.emplace_hint(document_ordinals_.end(), document_id, ordinal);
+        document_ids_.emplace_hint(document_ids_.end(), document_id);
+    }
+
+    //document_freq слова - число живых документов в его листе, счётчики постингов - суммы по всем листам.
+    //Прямой индекс хранит по слову на постинг живого документа, у удалённых он пуст
+    uint64_t posting_count = 0;
+    uint64_t dead_posting_count = 0;
+    PostingCursor cursor;
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        const PostingList& postings = index_.GetPostings(static_cast<int>(term_id));
+        int live_count = 0;
+        for (cursor.Reset(postings); !cursor.AtEnd(); cursor.Next()) {
+            live_count += documents_[cursor.Ordinal()].is_removed ? 0 : 1;
+        }
+        if (live_count != index_.GetStats(static_cast<int>(term_id)).document_freq) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        posting_count += postings.size();
+        dead_posting_count += postings.size() - live_count;
+    }
+    if (posting_count != posting_count_ || dead_posting_count != dead_posting_count_ || posting_count - dead_posting_count != forward_term_ids.size()) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+}
+
+std::set<std::string, std::less<>> SearchServer::ReadStopWords(SnapshotReader& reader) {
+    std::set<std::string, std::less<>> stop_words;
+    reader.ReadStrings([&stop_words](std::string_view word) {
+        stop_words.emplace_hint(stop_words.end(), word);
+    });
+    return stop_words;
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    SnapshotReader reader(path);
+    return SearchServer(reader);
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    writer.WriteStrings(stop_words_);
+    index_.Save(writer);
+    std::vector<int32_t> ids;
+    std::vector<int32_t> ratings;
+    std::vector<int32_t> statuses;
+    std::vector<uint8_t> removed;
+    std::vector<uint64_t> forward_offsets = {0};
+    std::vector<int32_t> forward_term_ids;
+    std::vector<double> forward_term_freqs;
+    for (const DocumentData& document_data : documents_) {
+        ids.push_back(document_data.id);
+        ratings.push_back(document_data.rating);
+        statuses.push_back(static_cast<int32_t>(document_data.status));
+        removed.push_back(document_data.is_removed);
+        forward_term_ids.insert(forward_term_ids.end(), document_data.term_ids.begin(), document_data.term_ids.end());
+        forward_term_freqs.insert(forward_term_freqs.end(), document_data.term_freqs.begin(), document_data.term_freqs.end());
+        forward_offsets.push_back(forward_term_ids.size());
+    }
+    writer.WriteArray(ids);
+    writer.WriteArray(ratings);
+    writer.WriteArray(statuses);
+    writer.WriteArray(removed);
+    writer.WriteArray(forward_offsets);
+    writer.WriteArray(forward_term_ids);
+    writer.WriteArray(forward_term_freqs);
+    writer.WriteValue<uint64_t>(posting_count_);
+    writer.WriteValue<uint64_t>(dead_posting_count_);
+    writer.Finish();
+}
+
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
-        using std::literals::string_literals::operator""s;
-        throw std::invalid_argument("Invalid document_id"s);
+    AddDocuments(std::execution::seq, {{document_id, document, status, ratings}});
+}
+
+void SearchServer::AddDocuments(std::execution::parallel_policy policy, const std::vector<NewDocument>& documents) {
+    AddDocumentsImpl(policy, documents);
+}
+
+void SearchServer::AddDocuments(std::execution::sequenced_policy policy, const std::vector<NewDocument>& documents) {
+    AddDocumentsImpl(policy, documents);
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+//Пакетная загрузка в четыре прохода: параллельная токенизация и подсчёт TF, добавление в словарь только новых
+//уникальных слов пакета, раскладка постингов по словам и дозапись их в постинг-листы, по листу на задачу.
+//Индекс не меняется, пока не проверены все документы пакета
+template <typename Policy>
+void SearchServer::AddDocumentsImpl(Policy policy, const std::vector<NewDocument>& documents) {
+    using std::literals::string_literals::operator""s;
+    const auto latency = MeasureLatency(metrics_.add_documents);
+    std::vector<int> new_ids(documents.size());
+    std::transform(documents.begin(), documents.end(), new_ids.begin(), [](const NewDocument& document) {
+        return document.id;
+    });
+    std::sort(new_ids.begin(), new_ids.end());
+    for (size_t i = 0; i < new_ids.size(); ++i) {
+        if (new_ids[i] < 0 || document_ordinals_.count(new_ids[i]) > 0 || (i > 0 && new_ids[i] == new_ids[i - 1])) {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+    }
+
+    struct TokenizedDocument {
+        std::vector<std::string_view> words; //Уникальные слова по алфавиту
+        std::vector<double> term_freqs;
+        std::vector<int> term_ids;
+        std::string_view invalid_word;
+        bool is_valid = true;
+        std::optional<int> original_id; //Документ - дубликат, в режиме дедупликации
+    };
+    std::vector<TokenizedDocument> tokenized(documents.size());
+    //Исключение внутри параллельного алгоритма вызывает std::terminate, поэтому ошибки только запоминаются
+    ForEachIndex(policy, documents.size(), [this, &documents, &tokenized](size_t index) {
+        TokenizedDocument& document = tokenized[index];
+        ForEachCheckedWord(documents[index].text, [this, &document](std::string_view word, bool is_valid) {
+            if (!is_valid) {
+                if (document.is_valid) {
+                    document.invalid_word = word;
+                    document.is_valid = false;
+                }
+            } else if (!IsStopWord(word)) {
+                document.words.push_back(word);
+            }
+        });
+        std::sort(document.words.begin(), document.words.end());
+        const double inv_word_count = 1.0 / document.words.size();
+        size_t unique_count = 0;
+        for (size_t pos = 0; pos < document.words.size();) {
+            const std::string_view word = document.words[pos];
+            double term_freq = 0;
+            for (; pos < document.words.size() && document.words[pos] == word; ++pos) {
+                term_freq += inv_word_count;
+            }
+            document.words[unique_count++] = word;
+            document.term_freqs.push_back(term_freq);
+        }
+        document.words.resize(unique_count);
+        document.term_ids.resize(unique_count);
+        std::transform(document.words.begin(), document.words.end(), document.term_ids.begin(), [this](std::string_view word) {
+            return index_.FindTerm(word);
+        });
+        //Документ с новым словом не может совпасть с проиндексированным
+        if (is_ingest_deduplication_enabled_ && document.is_valid
+            && std::find(document.term_ids.begin(), document.term_ids.end(), InvertedIndex::NO_TERM) == document.term_ids.end()) {
+            std::vector<int> sorted_term_ids = document.term_ids;
+            std::sort(sorted_term_ids.begin(), sorted_term_ids.end());
+            document.original_id = FindIndexedDuplicate(sorted_term_ids, ComputeTermSetFingerprint(sorted_term_ids));
+        }
+    });
+    for (const TokenizedDocument& document : tokenized) {
+        if (!document.is_valid) {
+            throw std::invalid_argument("Word "s + std::string(document.invalid_word) + " is invalid"s);
+        }
     }
-    const auto words = SplitIntoWordsNoStop(std::string(document));
 
-    const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        std::string_view word_sv = std::string_view (word_to_document_freqs_.find(word)->first);
-        documents_by_id_[document_id][word_sv] += inv_word_count;
+    //Дубликаты отбрасываются до того, как попадут в словарь и постинг-листы
+    std::vector<std::pair<int, int>> duplicates; //{ Ид дубликата, ид оригинала }
+    std::vector<size_t> accepted; //Номера добавляемых документов пакета
+    if (is_ingest_deduplication_enabled_) {
+        std::unordered_multimap<uint64_t, size_t> batch_fingerprints;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            TokenizedDocument& document = tokenized[i];
+            if (!document.original_id) {
+                const uint64_t fingerprint = ComputeWordSetFingerprint(document.words);
+                const auto [first, last] = batch_fingerprints.equal_range(fingerprint);
+                const auto it = std::find_if(first, last, [&](const auto& entry) {
+                    return tokenized[entry.second].words == document.words;
+                });
+                if (it == last) {
+                    batch_fingerprints.emplace(fingerprint, i);
+                    accepted.push_back(i);
+                    continue;
+                }
+                document.original_id = documents[it->second].id;
+            }
+            duplicates.emplace_back(documents[i].id, *document.original_id);
+        }
+        if (!duplicates.empty()) {
+            std::vector<TokenizedDocument> accepted_tokenized;
+            accepted_tokenized.reserve(accepted.size());
+            for (const size_t i : accepted) {
+                accepted_tokenized.push_back(std::move(tokenized[i]));
+            }
+            tokenized = std::move(accepted_tokenized);
+        }
+    } else {
+        accepted.resize(documents.size());
+        std::iota(accepted.begin(), accepted.end(), 0);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
 
-    document_ids_.insert(document_id);
+    //Слова пакета сильно повторяются, поэтому сортируются только уникальные
+    std::unordered_set<std::string_view> unique_new_words;
+    for (const TokenizedDocument& document : tokenized) {
+        for (size_t i = 0; i < document.words.size(); ++i) {
+            if (document.term_ids[i] == InvertedIndex::NO_TERM) {
+                unique_new_words.insert(document.words[i]);
+            }
+        }
+    }
+    std::vector<std::string_view> new_words(unique_new_words.begin(), unique_new_words.end());
+    std::sort(new_words.begin(), new_words.end());
+    for (const std::string_view word : new_words) {
+        index_.InternTerm(word);
+    }
+
+    struct BatchPosting {
+        int term_id;
+        int ordinal;
+        double term_freq;
+    };
+    const int first_ordinal = static_cast<int>(documents_.size());
+    std::vector<size_t> posting_offsets(tokenized.size() + 1, 0);
+    for (size_t i = 0; i < tokenized.size(); ++i) {
+        posting_offsets[i + 1] = posting_offsets[i] + tokenized[i].words.size();
+    }
+    std::vector<BatchPosting> postings(posting_offsets.back());
+    ForEachIndex(policy, tokenized.size(), [&](size_t index) {
+        TokenizedDocument& document = tokenized[index];
+        for (size_t i = 0; i < document.words.size(); ++i) {
+            if (document.term_ids[i] == InvertedIndex::NO_TERM) {
+                document.term_ids[i] = index_.FindTerm(document.words[i]);
+            }
+            const int term_id = document.term_ids[i];
+            postings[posting_offsets[index] + i] = {term_id, first_ordinal + static_cast<int>(index), document.term_freqs[i]};
+        }
+        //В DocumentData слова упорядочены по term_id
+        std::vector<std::pair<int, double>> by_term_id(document.words.size());
+        for (size_t i = 0; i < document.words.size(); ++i) {
+            by_term_id[i] = {document.term_ids[i], document.term_freqs[i]};
+        }
+        std::sort(by_term_id.begin(), by_term_id.end());
+        for (size_t i = 0; i < by_term_id.size(); ++i) {
+            document.term_ids[i] = by_term_id[i].first;
+            document.term_freqs[i] = by_term_id[i].second;
+        }
+    });
+
+    const auto by_term_and_ordinal = [](const BatchPosting& lhs, const BatchPosting& rhs) {
+        return std::tie(lhs.term_id, lhs.ordinal) < std::tie(rhs.term_id, rhs.ordinal);
+    };
+    if (std::is_same_v<Policy, std::execution::parallel_policy> && thread_pool_ != nullptr) {
+        thread_pool_->ParallelSort(postings.begin(), postings.end(), by_term_and_ordinal);
+    } else {
+        std::sort(policy, postings.begin(), postings.end(), by_term_and_ordinal);
+    }
+    std::vector<size_t> term_starts;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (i == 0 || postings[i].term_id != postings[i - 1].term_id) {
+            term_starts.push_back(i);
+        }
+    }
+    //Новые ordinal больше всех имеющихся, поэтому дозапись сохраняет порядок листов. У каждой задачи своё слово
+    ForEachIndex(policy, term_starts.size(), [this, &postings, &term_starts](size_t term_index) {
+        const size_t start = term_starts[term_index];
+        const int term_id = postings[start].term_id;
+        for (size_t i = start; i < postings.size() && postings[i].term_id == term_id; ++i) {
+            index_.AddPosting(term_id, postings[i].ordinal, postings[i].term_freq);
+        }
+    });
+
+    for (size_t i = 0; i < tokenized.size(); ++i) {
+        const NewDocument& document = documents[accepted[i]];
+        if (is_ingest_deduplication_enabled_) {
+            fingerprint_ids_.emplace(ComputeTermSetFingerprint(tokenized[i].term_ids), document.id);
+        }
+        documents_.push_back({document.id, ComputeAverageRating(document.ratings), document.status,
+                              std::move(tokenized[i].term_ids), std::move(tokenized[i].term_freqs)});
+        document_ordinals_.emplace(document.id, first_ordinal + static_cast<int>(i));
+        document_ids_.insert(document.id);
+    }
+    posting_count_ += postings.size();
+    if (!tokenized.empty()) {
+        ++generation_;
+        UpdateIndexGauges();
+    }
+    if (on_duplicate_) {
+        for (const auto& [duplicate_id, original_id] : duplicates) {
+            on_duplicate_(duplicate_id, original_id);
+        }
+    }
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, int top_count) const {
     return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
         return document_status == status;
-    });
+    }, top_count);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, int top_count) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, top_count);
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsExplained(std::string_view raw_query, QueryTrace& trace, DocumentStatus status,
+                                                              int top_count) const {
+    return FindTopDocumentsExplained(std::execution::seq, raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    }, trace, top_count);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+void SearchServer::QueryTrace::AddStage(std::string_view name, std::chrono::steady_clock::time_point& stage_start) {
+    const auto now = std::chrono::steady_clock::now();
+    stages.push_back({name, std::chrono::duration_cast<std::chrono::nanoseconds>(now - stage_start).count()});
+    stage_start = now;
+}
+
+void SearchServer::QueryTrace::Print(std::ostream& out) const {
+    using namespace std::literals;
+    out << "stages:"sv;
+    for (const Stage& stage : stages) {
+        out << ' ' << stage.name << '=' << stage.duration_ns << "ns"sv;
+    }
+    out << "\nterms:\n"sv;
+    for (const Term& term : terms) {
+        out << "  "sv << (term.is_minus ? "-"sv : ""sv) << term.word << " df="sv << term.document_freq
+            << " postings="sv << term.posting_count << " idf="sv << term.inverse_document_freq
+            << " max_contribution="sv << term.upper_bound << '\n';
+    }
+    out << "postings: total="sv << counters.postings_total << " traversed="sv << counters.postings_traversed
+        << " probed="sv << counters.postings_probed << '\n';
+    out << "documents: candidates="sv << counters.candidates << " minus_excluded="sv << counters.minus_excluded
+        << " after_minus="sv << counters.candidates - counters.minus_excluded << " predicate_rejected="sv << counters.predicate_rejected
+        << " pruned="sv << counters.pruned << " rescored="sv << counters.rescored << '\n';
+    for (const DocumentScore& document : documents) {
+        out << "  document_id="sv << document.document_id << " relevance="sv << document.relevance << " ="sv;
+        for (const auto& [word, contribution] : document.contributions) {
+            out << ' ' << word << ':' << contribution;
+        }
+        out << '\n';
+    }
+}
+
+SearchServer::QueryTrace::DocumentScore SearchServer::ExplainScore(const Document& document, const QueryTrace& trace) const {
+    //Слова в порядке запроса, как в ComputeExactRelevance
+    QueryTrace::DocumentScore score{document.id, document.relevance, {}};
+    const DocumentData& document_data = documents_[document_ordinals_.at(document.id)];
+    for (const QueryTrace::Term& term : trace.terms) {
+        if (term.is_minus) {
+            continue;
+        }
+        const int term_id = index_.FindTerm(term.word);
+        const auto it = std::lower_bound(document_data.term_ids.begin(), document_data.term_ids.end(), term_id);
+        if (it != document_data.term_ids.end() && *it == term_id) {
+            score.contributions.emplace_back(term.word, document_data.term_freqs[it - document_data.term_ids.begin()] * term.inverse_document_freq);
+        }
+    }
+    return score;
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ordinals_.size();
+}
+
+void SearchServer::SetThreadPool(ThreadPool* thread_pool) {
+    thread_pool_ = thread_pool;
+}
+
+void SearchServer::EnableIngestDeduplication(DuplicateHandler on_duplicate) {
+    on_duplicate_ = std::move(on_duplicate);
+    if (is_ingest_deduplication_enabled_) {
+        return;
+    }
+    fingerprint_ids_.clear();
+    fingerprint_ids_.reserve(document_ordinals_.size());
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        fingerprint_ids_.emplace(ComputeTermSetFingerprint(documents_[ordinal].term_ids), document_id);
+    }
+    is_ingest_deduplication_enabled_ = true;
+}
+
+void SearchServer::DisableIngestDeduplication() {
+    is_ingest_deduplication_enabled_ = false;
+    on_duplicate_ = nullptr;
+    fingerprint_ids_ = {};
+}
+
+bool SearchServer::IsIngestDeduplicationEnabled() const {
+    return is_ingest_deduplication_enabled_;
+}
+
+void SearchServer::SetMetrics(MetricsRegistry* metrics, std::string_view prefix) {
+    metrics_ = {};
+    if (metrics == nullptr) {
+        return;
+    }
+    const std::string base = std::string(prefix) + '.';
+    metrics_.find_top_documents = &metrics->GetHistogram(base + "find_top_documents_ns");
+    metrics_.find_top_documents_batch = &metrics->GetHistogram(base + "find_top_documents_batch_ns");
+    metrics_.match_document = &metrics->GetHistogram(base + "match_document_ns");
+    metrics_.match_documents = &metrics->GetHistogram(base + "match_documents_ns");
+    metrics_.add_documents = &metrics->GetHistogram(base + "add_documents_ns");
+    metrics_.remove_documents = &metrics->GetHistogram(base + "remove_documents_ns");
+    metrics_.postings_scanned = &metrics->GetCounter(base + "postings_scanned");
+    metrics_.documents_matched = &metrics->GetCounter(base + "documents_matched");
+    metrics_.minus_word_exclusions = &metrics->GetCounter(base + "minus_word_exclusions");
+    metrics_.documents = &metrics->GetGauge(base + "documents");
+    metrics_.terms = &metrics->GetGauge(base + "terms");
+    metrics_.postings = &metrics->GetGauge(base + "postings");
+    metrics_.dead_postings = &metrics->GetGauge(base + "dead_postings");
+    UpdateIndexGauges();
+}
+
+void SearchServer::UpdateIndexGauges() const {
+    if (metrics_.documents != nullptr) {
+        metrics_.documents->Set(document_ordinals_.size());
+        metrics_.terms->Set(index_.GetTermCount());
+        metrics_.postings->Set(posting_count_);
+        metrics_.dead_postings->Set(dead_posting_count_);
+    }
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+void SearchServer::NormalizeQuery(std::string_view raw_query, std::string& normalized_query) const {
+    const ScratchQuery scratch_query;
+    Query& query = *scratch_query;
+    ParseQuery(raw_query, query, true);
+    normalized_query.clear();
+    for (const std::string_view word : query.plus_words) {
+        normalized_query += word;
+        normalized_query.push_back(' ');
+    }
+    for (const std::string_view word : query.minus_words) {
+        normalized_query.push_back('-');
+        normalized_query += word;
+        normalized_query.push_back(' ');
+    }
 }
 
 std::set<int>::iterator SearchServer::begin() const {
@@ -53,172 +527,570 @@ std::set<int>::iterator SearchServer::end() const {
 
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     static const std::map<std::string_view, double> empty_map = {}; //Заглушка для возвращения ссылки на пустой мап
-    if(documents_by_id_.count(document_id) != 0) {
-        return documents_by_id_.at(document_id);
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end()) {
+        return empty_map;
+    }
+    //Мап строится из прямого индекса при первом запросе, узлы std::map не переезжают, поэтому ссылка остаётся валидной
+    std::lock_guard guard(word_frequencies_mutex_);
+    const auto [it, inserted] = word_frequencies_.try_emplace(document_id);
+    if (inserted) {
+        const DocumentData& document_data = documents_[ordinal_it->second];
+        for (size_t i = 0; i < document_data.term_ids.size(); ++i) {
+            it->second.emplace(index_.GetTerm(document_data.term_ids[i]), document_data.term_freqs[i]);
+        }
     }
-    return empty_map;
+    return it->second;
 }
 
-void SearchServer::RemoveDocument(std::execution::parallel_policy, int document_id) {
-    if(SearchServer::GetDocumentCount() == 0 || document_ids_.count(document_id) == 0) {
-        return;
+const std::vector<int>& SearchServer::GetDocumentTermIds(int document_id) const {
+    static const std::vector<int> empty_term_ids;
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end()) {
+        return empty_term_ids;
     }
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    std::vector<std::pair<std::string_view, double>> words(documents_by_id_.at(document_id).size());
-    std::transform(std::execution::par, documents_by_id_.at(document_id).begin(), documents_by_id_.at(document_id).end(),
-                   words.begin(), [](const auto& value) {
-                return value;
-            });
-    std::unique(std::execution::par, words.begin(), words.end());
-    std::list<std::string_view> temp_words;
-    std::for_each(std::execution::par, words.begin(), words.end(), [this, document_id, &temp_words](const auto &value) {
-        this->word_to_document_freqs_.at(std::string(value.first)).erase(document_id);
-        if (this->word_to_document_freqs_.at(std::string(value.first)).size() == 0) {
-            temp_words.push_back(value.first);
-        }
-    });
-    documents_by_id_.erase(document_id);
+    return documents_[ordinal_it->second].term_ids;
+}
 
-    if (!temp_words.empty()) {
-        std::for_each(std::execution::par, temp_words.begin(), temp_words.end(), [this](const std::string_view& word) {
-            this->word_to_document_freqs_.erase(std::string(word));
-        });
+uint64_t SearchServer::GetTermSetFingerprint(int document_id) const {
+    return ComputeTermSetFingerprint(GetDocumentTermIds(document_id));
+}
+
+void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id) {
+    const auto latency = MeasureLatency(metrics_.remove_documents);
+    if (RetireDocument(policy, document_id)) {
+        ++generation_;
+        CompactIndexIfNeeded();
+        UpdateIndexGauges();
     }
 }
 
-void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document_id) {
-    if(SearchServer::GetDocumentCount() == 0 || document_ids_.count(document_id) == 0) {
-        return;
+void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id) {
+    const auto latency = MeasureLatency(metrics_.remove_documents);
+    if (RetireDocument(policy, document_id)) {
+        ++generation_;
+        CompactIndexIfNeeded();
+        UpdateIndexGauges();
     }
-    //В задании указано сохранить поведение, поэтому старая реализация
-    document_ids_.erase(document_id);
-    std::set<std::string_view> words;
-    for(const auto& [word, stats] : documents_by_id_.at(document_id)) {
-        words.insert(word);
-    }
-    documents_by_id_.erase(document_id);
-    documents_.erase(document_id);
-    std::vector<std::string> temp;
-    for(auto& [word, stats] : word_to_document_freqs_) {
-        auto id_iter = stats.find(document_id);
-        if(id_iter != stats.end()) {
-            stats.erase(id_iter);
-            if(stats.empty()) {
-                temp.push_back(word);
-            }
-        }
+}
+
+void SearchServer::RemoveDocument(int document_id) {
+    SearchServer::RemoveDocument(std::execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    const auto latency = MeasureLatency(metrics_.remove_documents);
+    bool is_changed = false;
+    for (const int document_id : document_ids) {
+        is_changed |= RetireDocument(std::execution::seq, document_id);
     }
-    if(!temp.empty()) {
-        for(const std::string& word : temp) {
-            word_to_document_freqs_.erase(word);
+    if (is_changed) {
+        ++generation_;
+        CompactIndexIfNeeded();
+        UpdateIndexGauges();
+    }
+}
+
+//Удаление за O(длины документа): постинги остаются в листах, document_freq слов уменьшается сразу,
+//поэтому IDF оставшихся документов не зависит от того, было ли уплотнение
+template <typename Policy>
+bool SearchServer::RetireDocument(Policy policy, int document_id) {
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end()) {
+        return false;
+    }
+    DocumentData& document_data = documents_[ordinal_it->second];
+    //У каждого слова своя статистика, поэтому потоки не пересекаются
+    ForEachIndex(policy, document_data.term_ids.size(), [this, &document_data](size_t index) {
+        index_.RetirePosting(document_data.term_ids[index]);
+    });
+    dead_posting_count_ += document_data.term_ids.size();
+    if (is_ingest_deduplication_enabled_) {
+        const auto [first, last] = fingerprint_ids_.equal_range(ComputeTermSetFingerprint(document_data.term_ids));
+        const auto it = std::find_if(first, last, [document_id](const auto& entry) {
+            return entry.second == document_id;
+        });
+        if (it != last) {
+            fingerprint_ids_.erase(it);
         }
     }
+    document_data.is_removed = true;
+    document_data.term_ids = {};
+    document_data.term_freqs = {};
+    document_ordinals_.erase(ordinal_it);
+    document_ids_.erase(document_id);
+    word_frequencies_.erase(document_id);
+    return true;
 }
 
-void SearchServer::RemoveDocument(int document_id) {
-    SearchServer::RemoveDocument(std::execution::seq, document_id);
+void SearchServer::CompactIndexIfNeeded() {
+    if (dead_posting_count_ > COMPACTION_DEAD_POSTINGS_RATIO * posting_count_) {
+        CompactIndex();
+    }
+}
+
+void SearchServer::CompactIndex() {
+    std::vector<int> new_ordinals(documents_.size(), -1);
+    int live_count = 0;
+    for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (documents_[ordinal].is_removed) {
+            continue;
+        }
+        if (live_count != static_cast<int>(ordinal)) {
+            documents_[live_count] = std::move(documents_[ordinal]);
+        }
+        new_ordinals[ordinal] = live_count++;
+    }
+    documents_.resize(live_count);
+    for (auto& [document_id, ordinal] : document_ordinals_) {
+        ordinal = new_ordinals[ordinal];
+    }
+    index_.Compact(new_ordinals);
+    posting_count_ -= dead_posting_count_;
+    dead_posting_count_ = 0;
+    UpdateIndexGauges();
 }
+
 //using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 SearchServer::MatchResult SearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const {
+    const auto latency = MeasureLatency(metrics_.match_document);
     if(document_ids_.count(document_id) == 0) {
         using namespace std::literals;
         throw std::out_of_range("No such id"s);
     }
-    std::vector<std::string_view> words = SplitIntoWords(raw_query);
-    std::vector<std::string_view> plus_words, minus_words;
-    plus_words.reserve(words.size());
-    minus_words.reserve(words.size());
-    std::for_each(words.begin(), words.end(), [&plus_words, &minus_words](auto& word){
-        if (word.empty()) {
-            throw std::invalid_argument("Query word is empty");
-        }
-        bool is_minus = false;
-        if (word[0] == '-') {
-            is_minus = true;
-            word = word.substr(1);
-        }
-        if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-            using namespace std::literals;
-            throw std::invalid_argument("Query word "s + std::string(word) + " is invalid"s);
-        }
-        if(is_minus) {
-            minus_words.push_back(word);
-        } else {
-            plus_words.push_back(word);
+    const int ordinal = document_ordinals_.at(document_id);
+    const ScratchQuery scratch_query;
+    Query& query = *scratch_query;
+    ParseQuery(raw_query, query, true);
+    const std::vector<std::string_view>& plus_words = query.plus_words;
+    const std::vector<std::string_view>& minus_words = query.minus_words;
+
+    std::atomic<bool> has_minus_word = false;
+    ForEachIndex(std::execution::par, minus_words.size(), [this, ordinal, &minus_words, &has_minus_word](size_t index) {
+        if (!has_minus_word.load(std::memory_order_relaxed) && ContainsTerm(minus_words[index], ordinal)) {
+            has_minus_word = true;
         }
     });
-
-    if(std::any_of(std::execution::par, minus_words.begin(), minus_words.end(), [this, document_id](const auto& word){
-        auto pos = word_to_document_freqs_.find(word);
-        return pos != word_to_document_freqs_.end() && pos->second.count(document_id) != 0;
-    })) {
-        return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+    if (has_minus_word) {
+        return {std::vector<std::string_view>{}, documents_[ordinal].status};
     }
-    std::sort(std::execution::par, plus_words.begin(), plus_words.end());
-    auto plus_last = std::unique(std::execution::par, plus_words.begin(), plus_words.end());
-    plus_words.erase(plus_last, plus_words.end());
-    std::vector<std::string_view> matched_words(plus_words.size());
-
-
-    auto last = std::copy_if(std::execution::par, plus_words.begin(), plus_last, matched_words.begin(), [document_id, this](const auto& word){
-        auto pos = word_to_document_freqs_.find(word);
-        return pos != word_to_document_freqs_.end() && pos->second.count(document_id) != 0;
+    std::vector<char> is_matched(plus_words.size());
+    ForEachIndex(std::execution::par, plus_words.size(), [this, ordinal, &plus_words, &is_matched](size_t index) {
+        is_matched[index] = ContainsTerm(plus_words[index], ordinal);
     });
-
-    matched_words.erase(last, matched_words.end());
-    return {matched_words, documents_.at(document_id).status};
+    std::vector<std::string_view> matched_words;
+    for (size_t i = 0; i < plus_words.size(); ++i) {
+        if (is_matched[i]) {
+            matched_words.push_back(plus_words[i]);
+        }
+    }
+    //Возвращаем view на слова словаря, а не на текст запроса
+    std::transform(matched_words.begin(), matched_words.end(), matched_words.begin(), [this](std::string_view word) {
+        return index_.GetTerm(index_.FindTerm(word));
+    });
+    return {std::move(matched_words), documents_[ordinal].status};
 }
 
 SearchServer::MatchResult SearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const {
+    const auto latency = MeasureLatency(metrics_.match_document);
     if(document_ids_.count(document_id) == 0) {
         using namespace std::literals;
         throw std::out_of_range("No such id"s);
     }
-    const auto query = ParseQuery(raw_query, true);
+    const int ordinal = document_ordinals_.at(document_id);
+    const ScratchQuery scratch_query;
+    Query& query = *scratch_query;
+    ParseQuery(raw_query, query, true);
 
     std::vector<std::string_view> matched_words;
-    for (const std::string& word: query.minus_words) {
-        if (word_to_document_freqs_.at(word).count(document_id) != 0) {
-            return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+    matched_words.reserve(query.plus_words.size());
+    for (const std::string_view word: query.minus_words) {
+        if (ContainsTerm(word, ordinal)) {
+            return {std::vector<std::string_view>{}, documents_[ordinal].status};
         }
     }
-    for (const std::string& word: query.plus_words) {
-        auto pos = word_to_document_freqs_.find(word);
-        if (pos->second.count(document_id) != 0) {
-            matched_words.push_back(pos->first);
+    for (const std::string_view word: query.plus_words) {
+        const int term_id = index_.FindTerm(word);
+        if (term_id != InvertedIndex::NO_TERM && index_.GetPostings(term_id).Find(ordinal) >= 0) {
+            matched_words.push_back(index_.GetTerm(term_id));
         }
     }
-    return {matched_words, documents_.at(document_id).status};
+    return {std::move(matched_words), documents_[ordinal].status};
 }
 
 SearchServer::MatchResult SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
     return SearchServer::MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-bool SearchServer::IsStopWord(const std::string& word) const {
-    return stop_words_.count(word) > 0;
+size_t SearchServer::MatchBatchResult::size() const {
+    return document_ids.size();
 }
 
-bool SearchServer::IsValidWord(const std::string_view& word) {
-    // A valid word must not contain special characters
-    return std::none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
+IteratorRange<std::vector<std::string_view>::const_iterator> SearchServer::MatchBatchResult::operator[](size_t index) const {
+    return {words.begin() + offsets[index], words.begin() + offsets[index + 1]};
+}
+
+SearchServer::MatchBatchResult SearchServer::MatchDocuments(std::execution::parallel_policy policy, std::string_view raw_query,
+                                                            const std::vector<int>& document_ids) const {
+    return MatchDocumentsImpl(policy, raw_query, document_ids);
+}
+
+SearchServer::MatchBatchResult SearchServer::MatchDocuments(std::execution::sequenced_policy policy, std::string_view raw_query,
+                                                            const std::vector<int>& document_ids) const {
+    return MatchDocumentsImpl(policy, raw_query, document_ids);
+}
+
+SearchServer::MatchBatchResult SearchServer::MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+SearchServer::MatchBatchResult SearchServer::MatchDocuments(std::execution::parallel_policy policy, std::string_view raw_query) const {
+    return MatchDocumentsImpl(policy, raw_query, std::vector<int>(document_ids_.begin(), document_ids_.end()));
+}
+
+SearchServer::MatchBatchResult SearchServer::MatchDocuments(std::execution::sequenced_policy policy, std::string_view raw_query) const {
+    return MatchDocumentsImpl(policy, raw_query, std::vector<int>(document_ids_.begin(), document_ids_.end()));
+}
+
+SearchServer::MatchBatchResult SearchServer::MatchDocuments(std::string_view raw_query) const {
+    return MatchDocuments(std::execution::seq, raw_query);
+}
+
+template <typename Policy>
+SearchServer::MatchBatchResult SearchServer::MatchDocumentsImpl(Policy policy, std::string_view raw_query,
+                                                                const std::vector<int>& document_ids) const {
+    const auto latency = MeasureLatency(metrics_.match_documents);
+    const size_t document_count = document_ids.size();
+    MatchBatchResult result;
+    result.document_ids = document_ids;
+    result.statuses.resize(document_count);
+    //{ ordinal, номер документа в пакете } по возрастанию ordinal, чтобы курсоры по листам шли только вперёд
+    std::vector<std::pair<int, int>> ordinals(document_count);
+    for (size_t i = 0; i < document_count; ++i) {
+        const auto ordinal_it = document_ordinals_.find(document_ids[i]);
+        if (ordinal_it == document_ordinals_.end()) {
+            using namespace std::literals;
+            throw std::out_of_range("No such id"s);
+        }
+        ordinals[i] = {ordinal_it->second, static_cast<int>(i)};
+        result.statuses[i] = documents_[ordinal_it->second].status;
+    }
+    std::sort(ordinals.begin(), ordinals.end());
+
+    const ScratchQuery scratch_query;
+    Query& query = *scratch_query;
+    ParseQuery(raw_query, query, true);
+    //Слова, которых нет в словаре, не встречаются ни в одном документе
+    std::vector<int> plus_term_ids;
+    std::vector<int> minus_term_ids;
+    for (const std::string_view word : query.plus_words) {
+        if (const int term_id = index_.FindTerm(word); term_id != InvertedIndex::NO_TERM) {
+            plus_term_ids.push_back(term_id);
+        }
+    }
+    for (const std::string_view word : query.minus_words) {
+        if (const int term_id = index_.FindTerm(word); term_id != InvertedIndex::NO_TERM) {
+            minus_term_ids.push_back(term_id);
+        }
+    }
+
+    //is_matched[i * plus_count + term] - документ i пакета содержит плюс-слово term
+    const size_t plus_count = plus_term_ids.size();
+    std::vector<char> is_matched(document_count * plus_count);
+    std::vector<char> is_excluded(document_count);
+    const int chunk_count = GetChunkCount(policy, static_cast<int>(document_count));
+    ForEachIndex(policy, chunk_count, [&](int chunk) {
+        const size_t first = document_count * chunk / chunk_count;
+        const size_t last = document_count * (chunk + 1) / chunk_count;
+        PostingCursor cursor;
+        const auto for_each_containing = [&](int term_id, const auto& on_match) {
+            cursor.Reset(index_.GetPostings(term_id));
+            for (size_t i = first; i < last; ++i) {
+                cursor.Seek(ordinals[i].first);
+                if (cursor.AtEnd()) {
+                    break;
+                }
+                if (cursor.Ordinal() == ordinals[i].first) {
+                    on_match(ordinals[i].second);
+                }
+            }
+        };
+        for (const int term_id : minus_term_ids) {
+            for_each_containing(term_id, [&is_excluded](int index) {
+                is_excluded[index] = true;
+            });
+        }
+        for (size_t term = 0; term < plus_count; ++term) {
+            for_each_containing(plus_term_ids[term], [&is_matched, plus_count, term](int index) {
+                is_matched[index * plus_count + term] = true;
+            });
+        }
     });
+
+    result.offsets.reserve(document_count + 1);
+    for (size_t i = 0; i < document_count; ++i) {
+        if (!is_excluded[i]) {
+            for (size_t term = 0; term < plus_count; ++term) {
+                if (is_matched[i * plus_count + term]) {
+                    result.words.push_back(index_.GetTerm(plus_term_ids[term]));
+                }
+            }
+        }
+        result.offsets.push_back(result.words.size());
+    }
+    return result;
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const {
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            using std::literals::string_literals::operator""s;
-            throw std::invalid_argument("Word "s + word + " is invalid"s);
+SearchServer::PruningStats SearchServer::GetPruningStats() const {
+    return {postings_total_.load(), postings_traversed_.load(), postings_probed_.load()};
+}
+
+void SearchServer::ResetPruningStats() {
+    postings_total_ = 0;
+    postings_traversed_ = 0;
+    postings_probed_ = 0;
+}
+
+SearchServer::MemoryStats SearchServer::GetMemoryStats() const {
+    MemoryStats stats;
+    stats.posting_count = posting_count_;
+    stats.posting_bytes = index_.GetPostingMemoryUsage();
+    stats.term_bytes = index_.GetTermMemoryUsage();
+    for (const DocumentData& document_data : documents_) {
+        stats.forward_index_bytes += document_data.term_ids.size() * sizeof(int) + document_data.term_freqs.size() * sizeof(double);
+    }
+    return stats;
+}
+
+double SearchServer::ComputeExactRelevance(int ordinal, const PlusTerms& plus_terms) const {
+    //Складываем в порядке слов запроса, как при полном переборе, чтобы релевантность совпадала до бита
+    const DocumentData& document_data = documents_[ordinal];
+    double relevance = 0;
+    for (const PlusTerm& term : plus_terms) {
+        const auto it = std::lower_bound(document_data.term_ids.begin(), document_data.term_ids.end(), term.term_id);
+        if (it != document_data.term_ids.end() && *it == term.term_id) {
+            relevance += document_data.term_freqs[it - document_data.term_ids.begin()] * term.inverse_document_freq;
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+    }
+    return relevance;
+}
+
+size_t SearchServer::BatchResult::size() const {
+    return offsets.size() - 1;
+}
+
+IteratorRange<std::vector<Document>::const_iterator> SearchServer::BatchResult::operator[](size_t query_index) const {
+    return {documents.begin() + offsets[query_index], documents.begin() + offsets[query_index + 1]};
+}
+
+SearchServer::BatchResult SearchServer::FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string>& raw_queries,
+                                                              DocumentStatus status, int top_count) const {
+    return FindTopDocumentsBatchImpl(policy, raw_queries, status, top_count);
+}
+
+SearchServer::BatchResult SearchServer::FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string>& raw_queries,
+                                                              DocumentStatus status, int top_count) const {
+    return FindTopDocumentsBatchImpl(policy, raw_queries, status, top_count);
+}
+
+template <typename Policy>
+SearchServer::BatchResult SearchServer::FindTopDocumentsBatchImpl(Policy policy, const std::vector<std::string>& raw_queries,
+                                                                  DocumentStatus status, int top_count) const {
+    const auto latency = MeasureLatency(metrics_.find_top_documents_batch);
+    BatchResult result;
+    result.offsets.reserve(raw_queries.size() + 1);
+    for (size_t first_query = 0; first_query < raw_queries.size(); first_query += BATCH_QUERY_GROUP_SIZE) {
+        const size_t query_count = std::min<size_t>(BATCH_QUERY_GROUP_SIZE, raw_queries.size() - first_query);
+        FindTopDocumentsGroup(policy, raw_queries, first_query, query_count, status, top_count, result);
+    }
+    return result;
+}
+
+//Слова группы запросов сливаются в общий список: каждый постинг-лист обходится один раз, и TF * IDF постинга
+//добавляется в аккумуляторы всех запросов с этим словом. Отсечение MaxScore не применяется, потому что пороги
+//у запросов разные, но частичная релевантность по-прежнему служит верхней границей перед точным пересчётом
+template <typename Policy>
+void SearchServer::FindTopDocumentsGroup(Policy policy, const std::vector<std::string>& raw_queries, size_t first_query,
+                                         size_t query_count, DocumentStatus status, int top_count, BatchResult& result) const {
+    struct BatchTerm {
+        int term_id;
+        const PostingList* postings;
+        double inverse_document_freq;
+        std::pmr::vector<int> queries; //Повторяющееся в запросе слово учитывается столько раз, сколько FindTopDocuments
+    };
+    const ScratchArena arena;
+    std::pmr::memory_resource* const resource = arena.GetResource();
+    std::pmr::vector<PlusTerms> plus_terms(query_count, resource); //Для точного пересчёта, в порядке слов запроса
+    std::pmr::vector<BatchTerm> batch_plus_terms(resource);
+    std::pmr::vector<BatchTerm> batch_minus_terms(resource);
+    std::pmr::unordered_map<int, size_t> plus_term_indexes(resource); //{ term_id, позиция в batch_plus_terms }
+    std::pmr::unordered_map<int, size_t> minus_term_indexes(resource);
+    const auto add_use = [resource](std::pmr::vector<BatchTerm>& terms, std::pmr::unordered_map<int, size_t>& term_indexes,
+                                    int term_id, const PostingList* postings, double inverse_document_freq, int query) {
+        const auto [it, inserted] = term_indexes.emplace(term_id, terms.size());
+        if (inserted) {
+            terms.push_back({term_id, postings, inverse_document_freq, std::pmr::vector<int>({query}, resource)});
+        } else {
+            terms[it->second].queries.push_back(query);
+        }
+    };
+    const ScratchQuery scratch_query;
+    Query& query = *scratch_query;
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        ParseQuery(raw_queries[first_query + query_index], query);
+        for (const std::string_view word : query.plus_words) {
+            const int term_id = index_.FindTerm(word);
+            if (term_id != InvertedIndex::NO_TERM && index_.GetStats(term_id).document_freq > 0) {
+                const PostingList& postings = index_.GetPostings(term_id);
+                const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+                plus_terms[query_index].push_back({term_id, &postings, inverse_document_freq, postings.GetMaxTermFreq() * inverse_document_freq});
+                add_use(batch_plus_terms, plus_term_indexes, term_id, &postings, inverse_document_freq, query_index);
+            }
+        }
+        for (const std::string_view word : query.minus_words) {
+            const int term_id = index_.FindTerm(word);
+            if (term_id != InvertedIndex::NO_TERM) {
+                add_use(batch_minus_terms, minus_term_indexes, term_id, &index_.GetPostings(term_id), 0, query_index);
+            }
         }
     }
-    return words;
+
+    const int ordinal_count = static_cast<int>(documents_.size());
+    const int chunk_count = top_count > 0 ? GetChunkCount(policy, ordinal_count) : 0;
+    std::pmr::vector<std::pmr::vector<TopDocuments>> chunk_top(chunk_count, std::pmr::vector<TopDocuments>(query_count, TopDocuments(top_count)),
+                                                               resource);
+    ForEachIndex(policy, chunk_count, [&](int chunk) {
+        const int first = static_cast<int>(static_cast<int64_t>(ordinal_count) * chunk / chunk_count);
+        const int last = static_cast<int>(static_cast<int64_t>(ordinal_count) * (chunk + 1) / chunk_count);
+        static thread_local std::vector<ScoreAccumulator> accumulators;
+        static thread_local std::vector<PostingCursor> plus_cursors;
+        static thread_local std::vector<PostingCursor> minus_cursors;
+        if (accumulators.size() < query_count) {
+            accumulators.resize(query_count);
+        }
+        plus_cursors.resize(batch_plus_terms.size());
+        for (size_t term = 0; term < batch_plus_terms.size(); ++term) {
+            plus_cursors[term].Reset(*batch_plus_terms[term].postings);
+            plus_cursors[term].Seek(first);
+        }
+        minus_cursors.resize(batch_minus_terms.size());
+        for (size_t term = 0; term < batch_minus_terms.size(); ++term) {
+            minus_cursors[term].Reset(*batch_minus_terms[term].postings);
+            minus_cursors[term].Seek(first);
+        }
+
+        for (int window_first = first; window_first < last; window_first += PRUNING_WINDOW) {
+            const int window_last = std::min(last, window_first + PRUNING_WINDOW);
+            for (size_t query_index = 0; query_index < query_count; ++query_index) {
+                accumulators[query_index].Prepare(window_first, window_last - window_first);
+            }
+            for (size_t term = 0; term < batch_minus_terms.size(); ++term) {
+                PostingCursor& cursor = minus_cursors[term];
+                for (; !cursor.AtEnd() && cursor.Ordinal() < window_last; cursor.Next()) {
+                    for (const int query_index : batch_minus_terms[term].queries) {
+                        accumulators[query_index].Exclude(cursor.Ordinal());
+                    }
+                }
+            }
+            for (size_t term = 0; term < batch_plus_terms.size(); ++term) {
+                const BatchTerm& batch_term = batch_plus_terms[term];
+                PostingCursor& cursor = plus_cursors[term];
+                for (; !cursor.AtEnd() && cursor.Ordinal() < window_last; cursor.Next()) {
+                    const int ordinal = cursor.Ordinal();
+                    const auto& document_data = documents_[ordinal];
+                    const bool is_suitable = !document_data.is_removed && document_data.status == status;
+                    const double term_relevance = cursor.TermFreq() * batch_term.inverse_document_freq;
+                    for (const int query_index : batch_term.queries) {
+                        ScoreAccumulator& accumulator = accumulators[query_index];
+                        if (accumulator.IsExcluded(ordinal)) {
+                            continue;
+                        }
+                        if (!is_suitable) {
+                            accumulator.Exclude(ordinal);
+                            continue;
+                        }
+                        accumulator.Add(ordinal, term_relevance);
+                    }
+                }
+            }
+            for (size_t query_index = 0; query_index < query_count; ++query_index) {
+                TopDocuments& top = chunk_top[chunk][query_index];
+                ScoreAccumulator& accumulator = accumulators[query_index];
+                accumulator.ForEachScored([&](int ordinal, double partial_relevance) {
+                    if (top.IsFull() && partial_relevance < top.Worst().relevance - 2 * COMPARISSON_PRECISION) {
+                        return;
+                    }
+                    const auto& document_data = documents_[ordinal];
+                    top.Push({document_data.id, ComputeExactRelevance(ordinal, plus_terms[query_index]), document_data.rating});
+                });
+                accumulator.Clear();
+            }
+        }
+    });
+
+    //Выдача группы дописывается одним выделением, а не ростом по одному документу
+    size_t document_count = result.documents.size();
+    for (size_t query_index = 0; query_index < query_count && chunk_count > 0; ++query_index) {
+        for (int chunk = 1; chunk < chunk_count; ++chunk) {
+            chunk_top[0][query_index].Merge(chunk_top[chunk][query_index]);
+        }
+        document_count += chunk_top[0][query_index].GetSize();
+    }
+    if (document_count > result.documents.capacity()) {
+        result.documents.reserve(std::max(document_count, 2 * result.documents.capacity()));
+    }
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        if (chunk_count > 0) {
+            const std::vector<Document> documents = chunk_top[0][query_index].ExtractSorted();
+            result.documents.insert(result.documents.end(), documents.begin(), documents.end());
+        }
+        result.offsets.push_back(result.documents.size());
+    }
+}
+
+bool SearchServer::ContainsTerm(std::string_view word, int ordinal) const {
+    const int term_id = index_.FindTerm(word);
+    return term_id != InvertedIndex::NO_TERM && index_.GetPostings(term_id).Find(ordinal) >= 0;
+}
+
+uint64_t SearchServer::ComputeTermSetFingerprint(const std::vector<int>& term_ids) {
+    //Длина входит в начальное значение
+    uint64_t fingerprint = term_ids.size();
+    for (const int term_id : term_ids) {
+        fingerprint = MixFingerprint(fingerprint, static_cast<uint32_t>(term_id));
+    }
+    return fingerprint;
+}
+
+uint64_t SearchServer::ComputeWordSetFingerprint(const std::vector<std::string_view>& words) {
+    uint64_t fingerprint = words.size();
+    for (const std::string_view word : words) {
+        fingerprint = MixFingerprint(fingerprint, std::hash<std::string_view>{}(word));
+    }
+    return fingerprint;
+}
+
+std::optional<int> SearchServer::FindIndexedDuplicate(const std::vector<int>& term_ids, uint64_t fingerprint) const {
+    //Совпадение отпечатков проверяется сравнением слов. Из нескольких одинаковых документов - с меньшим ид
+    std::optional<int> original_id;
+    const auto [first, last] = fingerprint_ids_.equal_range(fingerprint);
+    for (auto it = first; it != last; ++it) {
+        if ((!original_id || it->second < *original_id) && documents_[document_ordinals_.at(it->second)].term_ids == term_ids) {
+            original_id = it->second;
+        }
+    }
+    return original_id;
+}
+
+bool SearchServer::IsStopWord(std::string_view word) const {
+    return stop_words_.count(word) > 0;
+}
+
+bool SearchServer::IsValidWord(const std::string_view& word) {
+    // A valid word must not contain special characters
+    return std::none_of(word.begin(), word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+    });
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -229,59 +1101,153 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string& text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text, bool is_valid) const {
     using std::literals::string_literals::operator""s;
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty"s);
     }
-    std::string word = text;
+    std::string_view word = text;
     bool is_minus = false;
     if (word[0] == '-') {
         is_minus = true;
-        word = word.substr(1);
+        word.remove_prefix(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw std::invalid_argument("Query word "s + text + " is invalid");
+    if (word.empty() || word[0] == '-' || !is_valid) {
+        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
 
     return {word, is_minus, IsStopWord(word)};
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-    return SearchServer::ParseQueryWord(std::string(text));
-}
-SearchServer::Query SearchServer::ParseQuery(const std::string& text, bool sort_required) const {
-    Query result;
-    for (const std::string& word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
+void SearchServer::ParseQuery(std::string_view text, Query& query, bool sort_required, bool expand_patterns) const {
+    using std::literals::string_literals::operator""s;
+    query.plus_words.clear();
+    query.minus_words.clear();
+    query.plus_patterns.clear();
+    query.minus_patterns.clear();
+    ForEachCheckedWord(text, [this, &query](std::string_view word, bool is_valid) {
+        const auto query_word = ParseQueryWord(word, is_valid);
         if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-//                result.minus_words.insert(query_word.data);
-                result.minus_words.push_back(query_word.data);
+            if (IsWordPattern(query_word.data)) {
+                //Шаблон без литерального начала обходил бы весь словарь
+                if (GetPatternPrefix(query_word.data).empty()) {
+                    throw std::invalid_argument("Query pattern "s + std::string(word) + " has no literal prefix"s);
+                }
+                (query_word.is_minus ? query.minus_patterns : query.plus_patterns).push_back(query_word.data);
+            } else if (query_word.is_minus) {
+                query.minus_words.push_back(query_word.data);
             } else {
-//                result.plus_words.insert(query_word.data);
-                result.plus_words.push_back(query_word.data);
+                query.plus_words.push_back(query_word.data);
             }
         }
+    });
+    if (expand_patterns) {
+        for (const std::string_view pattern : query.plus_patterns) {
+            query.pattern_terms.clear();
+            CollectPatternTerms(pattern, query.pattern_terms);
+            SelectPatternTerms(query.pattern_terms, MAX_PATTERN_EXPANSIONS, query.plus_words);
+        }
+        for (const std::string_view pattern : query.minus_patterns) {
+            query.pattern_terms.clear();
+            CollectPatternTerms(pattern, query.pattern_terms);
+            SelectPatternTerms(query.pattern_terms, query.pattern_terms.size(), query.minus_words);
+        }
     }
     if(sort_required) {
-        std::sort(std::execution::par, result.plus_words.begin(), result.plus_words.end());
-        std::sort(std::execution::par, result.minus_words.begin(), result.minus_words.end());
+        std::sort(query.plus_words.begin(), query.plus_words.end());
+        std::sort(query.minus_words.begin(), query.minus_words.end());
+        auto plus_last = std::unique(query.plus_words.begin(), query.plus_words.end());
+        query.plus_words.erase(plus_last, query.plus_words.end());
+        auto minus_last = std::unique(query.minus_words.begin(), query.minus_words.end());
+        query.minus_words.erase(minus_last, query.minus_words.end());
+    } else {
+        RemoveDuplicateWords(query);
     }
-    auto plus_last = std::unique(std::execution::par, result.plus_words.begin(), result.plus_words.end());
-    result.plus_words.erase(plus_last, result.plus_words.end());
-    auto minus_last = std::unique(std::execution::par, result.minus_words.begin(), result.minus_words.end());
-    result.minus_words.erase(minus_last, result.minus_words.end());
-    return result;
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool sort_required) const {
-    return SearchServer::ParseQuery(std::string(text), sort_required);
+void SearchServer::RemoveDuplicateWords(Query& query) {
+    //Буфер раскрытия шаблонов хранит пары { слово, позиция }: после сортировки повторы стоят рядом,
+    //а позиции первых вхождений идут первыми. Слова запроса не пустые, пустой view помечает повтор
+    for (std::vector<std::string_view>* words : {&query.plus_words, &query.minus_words}) {
+        std::vector<std::pair<std::string_view, int>>& positions = query.pattern_terms;
+        positions.clear();
+        for (size_t i = 0; i < words->size(); ++i) {
+            positions.emplace_back((*words)[i], static_cast<int>(i));
+        }
+        std::sort(positions.begin(), positions.end());
+        for (size_t i = 1; i < positions.size(); ++i) {
+            if (positions[i].first == positions[i - 1].first) {
+                (*words)[positions[i].second] = std::string_view();
+            }
+        }
+        words->erase(std::remove(words->begin(), words->end(), std::string_view()), words->end());
+    }
+}
+
+void SearchServer::CollectPatternTerms(std::string_view pattern, std::vector<std::pair<std::string_view, int>>& terms) const {
+    index_.ForEachTermWithPrefix(GetPatternPrefix(pattern), [this, pattern, &terms](int term_id) {
+        const std::string_view term = index_.GetTerm(term_id);
+        const int document_freq = index_.GetStats(term_id).document_freq;
+        if (document_freq > 0 && MatchesPattern(pattern, term)) {
+            terms.emplace_back(term, document_freq);
+        }
+    });
+}
+
+void SearchServer::SelectPatternTerms(std::vector<std::pair<std::string_view, int>>& terms, size_t max_count,
+                                      std::vector<std::string_view>& words) {
+    std::sort(terms.begin(), terms.end());
+    size_t unique_count = 0;
+    for (const auto& [term, document_freq] : terms) {
+        if (unique_count > 0 && terms[unique_count - 1].first == term) {
+            terms[unique_count - 1].second += document_freq;
+        } else {
+            terms[unique_count++] = {term, document_freq};
+        }
+    }
+    terms.resize(unique_count);
+    if (terms.size() > max_count) {
+        //Частые слова вперёд, при равной частоте - по алфавиту, чтобы выбор не зависел от порядка обхода словаря
+        std::nth_element(terms.begin(), terms.begin() + max_count, terms.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first;
+        });
+        terms.resize(max_count);
+        std::sort(terms.begin(), terms.end());
+    }
+    for (const auto& [term, document_freq] : terms) {
+        words.push_back(term);
+    }
+}
+
+SearchServer::ScratchQuery::ScratchQuery() {
+    struct Pool {
+        std::vector<std::unique_ptr<Query>> queries;
+        size_t depth = 0;
+    };
+    static thread_local Pool pool;
+    if (pool.depth == pool.queries.size()) {
+        pool.queries.push_back(std::make_unique<Query>());
+    }
+    query_ = pool.queries[pool.depth++].get();
+    depth_ = &pool.depth;
+}
+
+SearchServer::ScratchQuery::~ScratchQuery() {
+    --*depth_;
+}
+
+SearchServer::Query& SearchServer::ScratchQuery::operator*() const {
+    return *query_;
+}
+
+int SearchServer::GetDocumentFreq(std::string_view word) const {
+    const int term_id = index_.FindTerm(word);
+    return term_id == InvertedIndex::NO_TERM ? 0 : index_.GetStats(term_id).document_freq;
 }
 
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::ComputeWordInverseDocumentFreq(int term_id) const {
+    return index_.GetStats(term_id).GetInverseDocumentFreq(GetDocumentCount(), generation_);
 }
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document, DocumentStatus status,
@@ -310,11 +1276,10 @@ void MatchDocuments(const SearchServer& search_server, const std::string_view& q
     using std::literals::string_literals::operator""s;
     try {
         std::cout << "Матчинг документов по запросу: "s << query << std::endl;
-        const int document_count = search_server.GetDocumentCount();
-        for (int index = 0; index < document_count; ++index) {
-            const int document_id = *next(search_server.begin(), index);
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const SearchServer::MatchBatchResult result = search_server.MatchDocuments(query);
+        for (size_t index = 0; index < result.size(); ++index) {
+            const auto words = result[index];
+            PrintMatchDocumentResult(result.document_ids[index], {words.begin(), words.end()}, result.statuses[index]);
         }
     } catch (const std::invalid_argument& e) {
         std::cout << "Ошибка матчинга документов на запрос "s << query << ": "s << e.what() << std::endl;
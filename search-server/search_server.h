@@ -13,13 +13,47 @@
 #include <numeric>
 #include <execution>
 #include <typeinfo>
+#include <thread>
+#include <type_traits>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <memory_resource>
 
 #include "document.h"
+#include "paginator.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "thread_pool.h"
+#include "inverted_index.h"
+#include "scratch_arena.h"
+#include "log_duration.h"
+#include "metrics.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+
+    class SnapshotReader;
 
     const int MAX_RESULT_DOCUMENT_COUNT = 5;
-    const double COMPARISSON_PRECISION = 1e-6;
+    //Шаблон плюс-слова в запросе (cat*, c?t) раскрывается не больше чем в столько самых частых слов словаря
+    const size_t MAX_PATTERN_EXPANSIONS = 16;
+
+    //Отсекает перегрузки с политикой выполнения, иначе FindTopDocuments(query, 0) неоднозначен
+    template <typename Policy>
+    using IsExecutionPolicy = std::enable_if_t<std::is_execution_policy_v<std::decay_t<Policy>>, bool>;
+    //Минимальное число документов на поток в параллельных проходах по индексу
+    const int MIN_DOCUMENTS_PER_CHUNK = 4096;
+    //Размер окна порядковых номеров, после которого обновляется порог отсечения MaxScore
+    const int PRUNING_WINDOW = 4096;
+    //Во сколько раз несущественные постинги окна должны превосходить существенные, чтобы отсечение включилось
+    const uint64_t PRUNING_MIN_SKIP_RATIO = 4;
+    //Сколько запросов пакета обрабатываются за один проход по индексу, ограничивает память под аккумуляторы
+    const int BATCH_QUERY_GROUP_SIZE = 64;
+    //Доля постингов удалённых документов, при превышении которой индекс уплотняется
+    const double COMPACTION_DEAD_POSTINGS_RATIO = 0.25;
 
     class SearchServer {
 
@@ -29,80 +63,368 @@
         explicit SearchServer(const std::string& stop_words_text);
         explicit SearchServer(std::string_view stop_words_text);
 
+        //Снимок хранит стоп-слова, словарь, постинг-листы и прямой индекс, загрузка не токенизирует документы заново.
+        //Ошибки чтения и записи, повреждённый снимок или снимок другой версии - std::runtime_error
+        static SearchServer LoadSnapshot(const std::string& path);
+        void SaveSnapshot(const std::string& path) const;
+
         void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-        template <class ExecutionPolicy, typename DocumentPredicate>
-        std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+        struct NewDocument {
+            int id;
+            std::string_view text;
+            DocumentStatus status;
+            std::vector<int> ratings;
+        };
+        //Добавляет пакет документов целиком или, если хотя бы один некорректен, не добавляет ничего
+        void AddDocuments(std::execution::parallel_policy policy, const std::vector<NewDocument>& documents);
+        void AddDocuments(std::execution::sequenced_policy policy, const std::vector<NewDocument>& documents);
+        void AddDocuments(const std::vector<NewDocument>& documents);
+
+        //Режим дедупликации при добавлении: документ с тем же множеством слов, что у уже добавленного
+        //или у более раннего документа того же пакета, не попадает в индекс. Проверка идёт по отпечаткам множеств слов
+        //до изменения индекса. После добавления пакета on_duplicate(id дубликата, id оригинала) вызывается
+        //для каждого отброшенного документа. Режим не сохраняется в снимке
+        using DuplicateHandler = std::function<void(int duplicate_id, int original_id)>;
+        void EnableIngestDeduplication(DuplicateHandler on_duplicate = nullptr);
+        void DisableIngestDeduplication();
+        bool IsIngestDeduplicationEnabled() const;
+
+        //top_count - сколько лучших документов вернуть
+        template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true, typename DocumentPredicate>
+        std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                               int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
         template <typename DocumentPredicate>
-        std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+        std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                               int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+        template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true>
+        std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                               int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                               int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+        template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true>
+        std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                               int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        std::vector<Document> FindTopDocuments(std::string_view raw_query, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+        //Разбор одного запроса для FindTopDocumentsExplained
+        struct QueryTrace {
+            //Этапы в порядке выполнения: parse, resolve_terms, traverse, merge, sort
+            struct Stage {
+                std::string_view name;
+                int64_t duration_ns;
+            };
+            //Слова запроса, найденные в словаре. posting_count включает постинги удалённых, но ещё не вычищенных документов
+            struct Term {
+                std::string_view word;
+                bool is_minus;
+                int document_freq;
+                size_t posting_count;
+                double inverse_document_freq;
+                double upper_bound; //Наибольший вклад слова в релевантность, по нему работает отсечение
+            };
+            struct Counters {
+                uint64_t postings_total = 0;
+                uint64_t postings_traversed = 0;
+                uint64_t postings_probed = 0;
+                uint64_t candidates = 0; //Документы из постингов плюс-слов до фильтрации минус-словами
+                uint64_t minus_excluded = 0; //Из них исключены минус-словами, то же, что метрика minus_word_exclusions
+                uint64_t predicate_rejected = 0; //Из оставшихся отброшены предикатом или удалены
+                uint64_t pruned = 0; //Отброшены отсечением по верхней границе релевантности
+                uint64_t rescored = 0; //Для них посчитана точная релевантность
+            };
+            //Вклад каждого плюс-слова, содержащегося в документе, в его релевантность
+            struct DocumentScore {
+                int document_id;
+                double relevance;
+                std::vector<std::pair<std::string_view, double>> contributions;
+            };
+            std::vector<Stage> stages;
+            std::vector<Term> terms;
+            Counters counters;
+            std::vector<DocumentScore> documents; //В порядке выдачи
+
+            //Добавляет этап длительностью от stage_start до текущего момента и переносит stage_start на текущий момент
+            void AddStage(std::string_view name, std::chrono::steady_clock::time_point& stage_start);
+            void Print(std::ostream& out) const;
+        };
+        //Выдача совпадает с FindTopDocuments, trace заполняется разбором запроса. Учёт стоит только в этих перегрузках:
+        //FindTopDocuments собирается без него
+        template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true, typename DocumentPredicate>
+        std::vector<Document> FindTopDocumentsExplained(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                        QueryTrace& trace, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        std::vector<Document> FindTopDocumentsExplained(std::string_view raw_query, QueryTrace& trace, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                        int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+        //Выдачи пакета запросов в одном непрерывном буфере: выдача запроса i - documents[offsets[i], offsets[i + 1])
+        struct BatchResult {
+            std::vector<Document> documents;
+            std::vector<size_t> offsets = {0};
+
+            size_t size() const;
+            IteratorRange<std::vector<Document>::const_iterator> operator[](size_t query_index) const;
+        };
+        //Пакет выполняется за общий проход по индексу: постинг-лист слова, встречающегося в нескольких запросах,
+        //читается один раз для всех них. Выдача каждого запроса совпадает с FindTopDocuments(query, status, top_count)
+        BatchResult FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string>& raw_queries,
+                                          DocumentStatus status = DocumentStatus::ACTUAL, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        BatchResult FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string>& raw_queries,
+                                          DocumentStatus status = DocumentStatus::ACTUAL, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-        template <class ExecutionPolicy>
-        std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
-        std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+        int GetDocumentCount() const;
+        //Пул, на котором выполняются перегрузки с std::execution::par. Без пула они идут через std::execution::par.
+        //Пул должен жить, пока используется сервером, nullptr возвращает std::execution::par
+        void SetThreadPool(ThreadPool* thread_pool);
 
-        template <class ExecutionPolicy>
-        std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
-        std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+        //Реестр, в который сервер пишет задержки операций, счётчики поиска и размер индекса под именами prefix.*.
+        //Реестр должен жить, пока используется сервером, nullptr отключает учёт
+        void SetMetrics(MetricsRegistry* metrics, std::string_view prefix = "search_server");
 
-        int GetDocumentCount() const;
+        //Меняется при каждом изменении набора документов, при одном поколении одинаковые запросы дают одинаковую выдачу
+        uint64_t GetGeneration() const;
+        //Каноническая запись запроса: плюс- и минус-слова без стоп-слов и повторов по возрастанию.
+        //Запросы с одной записью дают одинаковую выдачу. Некорректный запрос - std::invalid_argument
+        void NormalizeQuery(std::string_view raw_query, std::string& normalized_query) const;
 
         std::set<int>::iterator begin() const;
         std::set<int>::iterator end() const;
 
         const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+        //Идентификаторы уникальных слов документа по возрастанию, для отсутствующего документа - пустой вектор.
+        //Идентификатор слова не меняется всё время жизни сервера
+        const std::vector<int>& GetDocumentTermIds(int document_id) const;
+        //64-битный отпечаток множества слов документа: у документов с одинаковыми множествами отпечатки равны,
+        //у разных совпадают с вероятностью порядка 2^-64
+        uint64_t GetTermSetFingerprint(int document_id) const;
 
         void RemoveDocument(std::execution::parallel_policy, int document_id);
         void RemoveDocument(std::execution::sequenced_policy, int document_id);
         void RemoveDocument(int document_id);
+        //Удалённые документы сразу исчезают из выдачи, а их постинги вычищаются при уплотнении индекса
+        void RemoveDocuments(const std::vector<int>& document_ids);
+        //Удаляет из постинг-листов постинги удалённых документов и перенумеровывает оставшиеся документы.
+        //Вызывается автоматически, когда доля таких постингов превышает COMPACTION_DEAD_POSTINGS_RATIO
+        void CompactIndex();
 
         using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
         MatchResult MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
         MatchResult MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
         MatchResult MatchDocument(std::string_view raw_query, int document_id) const;
 
+        //Совпавшие слова пакета документов в одном буфере: слова документа i - words[offsets[i], offsets[i + 1]).
+        //Слова и статус документа те же, что вернул бы MatchDocument
+        struct MatchBatchResult {
+            std::vector<int> document_ids;
+            std::vector<DocumentStatus> statuses;
+            std::vector<std::string_view> words;
+            std::vector<size_t> offsets = {0};
+
+            size_t size() const;
+            IteratorRange<std::vector<std::string_view>::const_iterator> operator[](size_t index) const;
+        };
+        //Запрос разбирается один раз, постинг-лист каждого его слова проходится один раз для всего пакета.
+        //Документы результата идут в порядке document_ids, без document_ids - все документы по возрастанию id.
+        //Отсутствующий id - std::out_of_range
+        MatchBatchResult MatchDocuments(std::execution::parallel_policy policy, std::string_view raw_query,
+                                        const std::vector<int>& document_ids) const;
+        MatchBatchResult MatchDocuments(std::execution::sequenced_policy policy, std::string_view raw_query,
+                                        const std::vector<int>& document_ids) const;
+        MatchBatchResult MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+        MatchBatchResult MatchDocuments(std::execution::parallel_policy policy, std::string_view raw_query) const;
+        MatchBatchResult MatchDocuments(std::execution::sequenced_policy policy, std::string_view raw_query) const;
+        MatchBatchResult MatchDocuments(std::string_view raw_query) const;
+
+        //Счётчики постингов плюс-слов, накопленные всеми запросами: сколько попало в диапазон поиска
+        //и сколько из них было прочитано. Остальные пропущены отсечением MaxScore
+        struct PruningStats {
+            uint64_t postings_total = 0;
+            uint64_t postings_traversed = 0;
+            uint64_t postings_probed = 0;
+        };
+        PruningStats GetPruningStats() const;
+        void ResetPruningStats();
+
+        //Объём основных структур индекса в байтах без резерва векторов и накладных расходов аллокатора
+        struct MemoryStats {
+            uint64_t posting_count = 0;
+            uint64_t posting_bytes = 0;
+            uint64_t forward_index_bytes = 0;
+            uint64_t term_bytes = 0; //Словарь слов, вместе с резервом
+        };
+        MemoryStats GetMemoryStats() const;
+
     private:
+        friend class ShardedSearchServer;
+
         struct DocumentData {
+            int id;
             int rating;
             DocumentStatus status;
+            std::vector<int> term_ids; //Уникальные слова документа по возрастанию term_id
+            std::vector<double> term_freqs; //TF слов из term_ids
+            bool is_removed = false;
         };
-        const std::set<std::string> stop_words_;
-        std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-        std::map<int, DocumentData> documents_;
-        std::map<int, std::map<std::string_view, double>> documents_by_id_; //{ Ид документа, {слово, TF}}
+        const std::set<std::string, std::less<>> stop_words_;
+        InvertedIndex index_;
+        std::vector<DocumentData> documents_; //По порядковому номеру документа (ordinal), номера не переиспользуются
+        std::map<int, int> document_ordinals_; //{ Ид документа, ordinal }
+        mutable std::map<int, std::map<std::string_view, double>> word_frequencies_; //{ Ид документа, {слово, TF}}, строится по запросу
+        mutable std::mutex word_frequencies_mutex_;
         std::set<int> document_ids_;
+        uint64_t generation_ = 1; //Меняется при каждом добавлении и удалении документа
+        size_t posting_count_ = 0; //Все постинги в листах индекса
+        size_t dead_posting_count_ = 0; //Из них принадлежащие удалённым документам
+        mutable std::atomic<uint64_t> postings_total_ = 0;
+        mutable std::atomic<uint64_t> postings_traversed_ = 0;
+        mutable std::atomic<uint64_t> postings_probed_ = 0;
+        ThreadPool* thread_pool_ = nullptr;
+        bool is_ingest_deduplication_enabled_ = false;
+        DuplicateHandler on_duplicate_;
+        std::unordered_multimap<uint64_t, int> fingerprint_ids_; //{ Отпечаток множества слов, ид документа }, только в режиме дедупликации
+        //Метрики из реестра SetMetrics, без реестра все указатели нулевые
+        struct ServerMetrics {
+            LatencyHistogram* find_top_documents = nullptr;
+            LatencyHistogram* find_top_documents_batch = nullptr;
+            LatencyHistogram* match_document = nullptr;
+            LatencyHistogram* match_documents = nullptr;
+            LatencyHistogram* add_documents = nullptr;
+            LatencyHistogram* remove_documents = nullptr;
+            Counter* postings_scanned = nullptr; //Прочитанные и проверенные постинги плюс-слов
+            Counter* documents_matched = nullptr; //Документы, для которых посчитана точная релевантность
+            Counter* minus_word_exclusions = nullptr; //Документы из постингов плюс-слов, исключённые минус-словом
+            Gauge* documents = nullptr;
+            Gauge* terms = nullptr;
+            Gauge* postings = nullptr;
+            Gauge* dead_postings = nullptr;
+        };
+        ServerMetrics metrics_;
 
-        bool IsStopWord(const std::string& word) const;
+        explicit SearchServer(SnapshotReader& reader);
+        static std::set<std::string, std::less<>> ReadStopWords(SnapshotReader& reader);
 
-        static bool IsValidWord(const std::string_view& word);
+        template <typename Policy>
+        void AddDocumentsImpl(Policy policy, const std::vector<NewDocument>& documents);
 
-        std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+        //Помечает документ удалённым, возвращает false, если такого документа нет
+        template <typename Policy>
+        bool RetireDocument(Policy policy, int document_id);
+        void CompactIndexIfNeeded();
+        void UpdateIndexGauges() const;
+        bool ContainsTerm(std::string_view word, int ordinal) const;
+
+        bool IsStopWord(std::string_view word) const;
+
+        static bool IsValidWord(const std::string_view& word);
 
         static int ComputeAverageRating(const std::vector<int>& ratings);
+        //term_ids - по возрастанию
+        static uint64_t ComputeTermSetFingerprint(const std::vector<int>& term_ids);
+        //Отпечаток по самим словам, для документов пакета до добавления слов в словарь. words - уникальные, по алфавиту
+        static uint64_t ComputeWordSetFingerprint(const std::vector<std::string_view>& words);
+        //Наименьший ид документа с множеством слов term_ids (по возрастанию)
+        std::optional<int> FindIndexedDuplicate(const std::vector<int>& term_ids, uint64_t fingerprint) const;
 
         struct QueryWord {
-            std::string data;
+            std::string_view data;
             bool is_minus;
             bool is_stop;
         };
 
-        QueryWord ParseQueryWord(const std::string& text) const;
-        QueryWord ParseQueryWord(std::string_view text) const;
+        //is_valid - нет ли в слове управляющих символов, проверяется токенизатором
+        QueryWord ParseQueryWord(std::string_view text, bool is_valid) const;
 
+        //Слова запроса - view на текст запроса, он должен жить, пока используется Query.
+        //Слова из раскрытых шаблонов - view на словарь индекса
         struct Query {
-            std::vector<std::string> plus_words;
-            std::vector<std::string> minus_words;
+            std::vector<std::string_view> plus_words;
+            std::vector<std::string_view> minus_words;
+            std::vector<std::string_view> plus_patterns;
+            std::vector<std::string_view> minus_patterns;
+            std::vector<std::pair<std::string_view, int>> pattern_terms; //Буфер раскрытия шаблона: { слово, document_freq }
+        };
+
+        //Буфер Query, переиспользуемый запросами одного потока, чтобы разбор не выделял память.
+        //Вложенный запрос в том же потоке (поток, ожидающий параллельный алгоритм, может выполнять
+        //чужие задачи) получает следующий буфер из пула
+        class ScratchQuery {
+        public:
+            ScratchQuery();
+            ~ScratchQuery();
+            ScratchQuery(const ScratchQuery&) = delete;
+            ScratchQuery& operator=(const ScratchQuery&) = delete;
+
+            Query& operator*() const;
+
+        private:
+            Query* query_;
+            size_t* depth_;
+        };
+
+        //Заполняет query, переиспользуя её память. Шаблоны раскрываются по словарю этого индекса,
+        //при expand_patterns == false остаются в plus_patterns и minus_patterns. Шаблон, начинающийся с '*' или '?',
+        //не раскрывается по префиксу словаря и отклоняется как invalid_argument
+        void ParseQuery(std::string_view text, Query& query, bool sort_required = false, bool expand_patterns = true) const;
+        //Дописывает в terms слова словаря с живыми документами, подходящие под шаблон
+        void CollectPatternTerms(std::string_view pattern, std::vector<std::pair<std::string_view, int>>& terms) const;
+        //Складывает document_freq повторяющихся слов (раскрытия одного шаблона по нескольким индексам), оставляет
+        //max_count самых частых и дописывает их в words. Минус-шаблоны раскрываются полностью: иначе в выдачу
+        //попали бы документы с редкими исключёнными словами
+        static void SelectPatternTerms(std::vector<std::pair<std::string_view, int>>& terms, size_t max_count,
+                                       std::vector<std::string_view>& words);
+        //Убирает повторы плюс- и минус-слов с сохранением порядка первых вхождений. Раскрытие шаблона
+        //может повторить слово запроса не рядом с ним, поэтому std::unique не хватает
+        static void RemoveDuplicateWords(Query& query);
+
+        // Existence required. Берёт IDF из таблицы статистики слов, логарифм считается раз на поколение индекса
+        double ComputeWordInverseDocumentFreq(int term_id) const;
+
+        struct PlusTerm {
+            int term_id;
+            const PostingList* postings;
+            double inverse_document_freq;
+            double upper_bound; //max TF * IDF
         };
+        //Рабочие массивы запроса выделяются из ScratchArena
+        using PlusTerms = std::pmr::vector<PlusTerm>;
 
-        Query ParseQuery(const std::string& text, bool sort_required = false) const;
-        Query ParseQuery(std::string_view text, bool sort_required = false) const;
+        double ComputeExactRelevance(int ordinal, const PlusTerms& plus_terms) const;
 
-        // Existence required
-        double ComputeWordInverseDocumentFreq(const std::string& word) const;
+        template <typename Policy>
+        int GetChunkCount(const Policy& policy, int ordinal_count) const;
 
-        template <typename Policy, typename DocumentPredicate>
-        std::vector<Document> FindAllDocuments(Policy policy, const Query& query, DocumentPredicate document_predicate) const;
-        template <typename DocumentPredicate>
-        std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+        //Вызывает func(index) для index из [0, count): по порядку для seq, для параллельных политик - на пуле
+        //из SetThreadPool или через std::for_each. Без пула исключение из func вызывает std::terminate
+        template <typename Policy, typename Func>
+        void ForEachIndex(const Policy& policy, size_t count, const Func& func) const;
+
+        //Статистика плюс-слов запроса по нескольким индексам, чтобы IDF не зависел от того, в каком индексе документ
+        struct GlobalTermStats {
+            int document_count = 0;
+            std::vector<int> document_freqs; //В порядке Query::plus_words
+        };
+        int GetDocumentFreq(std::string_view word) const;
+
+        template <typename Policy>
+        BatchResult FindTopDocumentsBatchImpl(Policy policy, const std::vector<std::string>& raw_queries, DocumentStatus status,
+                                              int top_count) const;
+        //Дописывает в result выдачи запросов [first_query, first_query + query_count)
+        template <typename Policy>
+        void FindTopDocumentsGroup(Policy policy, const std::vector<std::string>& raw_queries, size_t first_query,
+                                   size_t query_count, DocumentStatus status, int top_count, BatchResult& result) const;
+
+        template <typename Policy>
+        MatchBatchResult MatchDocumentsImpl(Policy policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+        //Тип-заглушка для FindTopMatches без разбора запроса: весь учёт под if constexpr и не компилируется
+        struct NoQueryTrace {};
+        //global_stats == nullptr - IDF по этому индексу. С Trace = QueryTrace заполняет этапы, слова и счётчики trace
+        template <typename Policy, typename DocumentPredicate, typename Trace = NoQueryTrace>
+        TopDocuments FindTopMatches(Policy policy, const Query& query, DocumentPredicate document_predicate, int top_count,
+                                    const GlobalTermStats* global_stats = nullptr, Trace* trace = nullptr) const;
+        //Вклад слов trace.terms в релевантность документа
+        QueryTrace::DocumentScore ExplainScore(const Document& document, const QueryTrace& trace) const;
     };
 
     void AddDocument(SearchServer& search_server, int document_id, std::string_view document, DocumentStatus status,
@@ -122,76 +444,316 @@
         }
     }
 
-    template <class ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-        const auto query = ParseQuery(raw_query);
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-        sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < COMPARISSON_PRECISION) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-        return matched_documents;
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>, typename DocumentPredicate>
+    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         int top_count) const {
+        const auto latency = MeasureLatency(metrics_.find_top_documents);
+        const ScratchQuery query;
+        ParseQuery(raw_query, *query);
+        return FindTopMatches(policy, *query, document_predicate, top_count).ExtractSorted();
     }
 
-    template <class ExecutionPolicy>
-    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>>
+    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                                         int top_count) const {
         return SearchServer::FindTopDocuments(policy, raw_query, [status](int, DocumentStatus document_status, int) {
             return document_status == status;
-        });
+        }, top_count);
     }
 
-    template <class ExecutionPolicy>
-    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>>
+    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, int top_count) const {
         return SearchServer::FindTopDocuments(policy, raw_query, [](int, DocumentStatus status, int) {
            return status == DocumentStatus::ACTUAL;
-        });
+        }, top_count);
     }
 
     template<typename DocumentPredicate>
-    std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, int top_count) const {
+        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_count);
     }
 
-    template <typename Policy, typename DocumentPredicate>
-    std::vector<Document> SearchServer::FindAllDocuments(Policy policy, const Query& query, DocumentPredicate document_predicate) const {
-        ConcurrentMap<int, double> document_to_relevance(50);
-        std::for_each(policy, query.plus_words.begin(), query.plus_words.end(),[this, &document_predicate, &document_to_relevance](const std::string& word) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                return ;
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>, typename DocumentPredicate>
+    std::vector<Document> SearchServer::FindTopDocumentsExplained(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                                  DocumentPredicate document_predicate, QueryTrace& trace, int top_count) const {
+        trace = {};
+        auto stage_start = std::chrono::steady_clock::now();
+        const ScratchQuery query;
+        ParseQuery(raw_query, *query);
+        trace.AddStage("parse", stage_start);
+        TopDocuments top = FindTopMatches(policy, *query, document_predicate, top_count, nullptr, &trace);
+        stage_start = std::chrono::steady_clock::now();
+        std::vector<Document> result = top.ExtractSorted();
+        trace.AddStage("sort", stage_start);
+        for (const Document& document : result) {
+            trace.documents.push_back(ExplainScore(document, trace));
+        }
+        return result;
+    }
+
+    //Поиск с динамическим отсечением MaxScore. Слова запроса упорядочиваются по верхней границе вклада в релевантность.
+    //Префикс слов, суммарная граница которых ниже порога попадания в выдачу, "несущественный": документы, содержащие
+    //только такие слова, в выдачу не попадут, поэтому их постинги не перебираются, а только проверяются для кандидатов
+    //из существенных слов. Порог пересчитывается в каждом окне из PRUNING_WINDOW документов
+    template <typename Policy, typename DocumentPredicate, typename Trace>
+    TopDocuments SearchServer::FindTopMatches(Policy policy, const Query& query, DocumentPredicate document_predicate, int top_count,
+                                              const GlobalTermStats* global_stats, Trace* trace) const {
+        constexpr bool IS_TRACED = std::is_same_v<Trace, QueryTrace>;
+        [[maybe_unused]] std::chrono::steady_clock::time_point stage_start;
+        if constexpr (IS_TRACED) {
+            stage_start = std::chrono::steady_clock::now();
+        }
+        const ScratchArena arena;
+        PlusTerms plus_terms(arena.GetResource()); //В порядке слов запроса
+        plus_terms.reserve(query.plus_words.size());
+        for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+            const int term_id = index_.FindTerm(query.plus_words[word_index]);
+            if (term_id != InvertedIndex::NO_TERM && index_.GetStats(term_id).document_freq > 0) {
+                const PostingList& postings = index_.GetPostings(term_id);
+                const double inverse_document_freq = global_stats == nullptr
+                    ? ComputeWordInverseDocumentFreq(term_id)
+                    : TermStats::ComputeInverseDocumentFreq(global_stats->document_count, global_stats->document_freqs[word_index]);
+                plus_terms.push_back({term_id, &postings, inverse_document_freq, postings.GetMaxTermFreq() * inverse_document_freq});
+                if constexpr (IS_TRACED) {
+                    const int document_freq = global_stats == nullptr ? index_.GetStats(term_id).document_freq
+                                                                      : global_stats->document_freqs[word_index];
+                    trace->terms.push_back({index_.GetTerm(term_id), false, document_freq, postings.size(), inverse_document_freq,
+                                            plus_terms.back().upper_bound});
+                }
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if(document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+        }
+        std::pmr::vector<const PostingList*> minus_postings(arena.GetResource());
+        minus_postings.reserve(query.minus_words.size());
+        for (const std::string_view word : query.minus_words) {
+            const int term_id = index_.FindTerm(word);
+            if (term_id != InvertedIndex::NO_TERM) {
+                minus_postings.push_back(&index_.GetPostings(term_id));
+                if constexpr (IS_TRACED) {
+                    trace->terms.push_back({index_.GetTerm(term_id), true, index_.GetStats(term_id).document_freq,
+                                            minus_postings.back()->size(), 0, 0});
                 }
             }
+        }
+        if constexpr (IS_TRACED) {
+            trace->AddStage("resolve_terms", stage_start);
+        }
+        if (plus_terms.empty() || top_count <= 0) {
+            return TopDocuments(top_count);
+        }
+        const int term_count = static_cast<int>(plus_terms.size());
+        std::pmr::vector<int> by_bound(term_count, arena.GetResource());
+        std::iota(by_bound.begin(), by_bound.end(), 0);
+        //Равные границы по порядку слов, как при устойчивой сортировке: stable_sort выделяет буфер в глобальной куче
+        std::sort(by_bound.begin(), by_bound.end(), [&plus_terms](int lhs, int rhs) {
+            if (plus_terms[lhs].upper_bound != plus_terms[rhs].upper_bound) {
+                return plus_terms[lhs].upper_bound < plus_terms[rhs].upper_bound;
+            }
+            return lhs < rhs;
         });
-        std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](const std::string& word) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                return;
+
+        //Документы делятся на непересекающиеся диапазоны порядковых номеров, каждый диапазон
+        //считается в своём потоке в собственном аккумуляторе, поэтому блокировки не нужны
+        const int ordinal_count = static_cast<int>(documents_.size());
+        const int chunk_count = GetChunkCount(policy, ordinal_count);
+        std::pmr::vector<TopDocuments> chunk_top(chunk_count, TopDocuments(top_count), arena.GetResource());
+        //Без разбора запроса счётчики - пустая заглушка
+        [[maybe_unused]] std::conditional_t<IS_TRACED, std::vector<QueryTrace::Counters>, NoQueryTrace> chunk_counters;
+        if constexpr (IS_TRACED) {
+            chunk_counters.resize(chunk_count);
+        }
+        ForEachIndex(policy, chunk_count, [&](int chunk) {
+            const int first = static_cast<int>(static_cast<int64_t>(ordinal_count) * chunk / chunk_count);
+            const int last = static_cast<int>(static_cast<int64_t>(ordinal_count) * (chunk + 1) / chunk_count);
+            static thread_local ScoreAccumulator accumulator;
+            static thread_local std::vector<PostingCursor> cursors;
+            static thread_local std::vector<PostingCursor> minus_cursors;
+            uint64_t postings_total = 0;
+            uint64_t postings_traversed = 0;
+            uint64_t postings_probed = 0;
+            uint64_t documents_matched = 0;
+            uint64_t minus_word_exclusions = 0;
+            [[maybe_unused]] std::conditional_t<IS_TRACED, QueryTrace::Counters, NoQueryTrace> counters;
+            cursors.resize(term_count);
+            for (int term = 0; term < term_count; ++term) {
+                cursors[term].Reset(*plus_terms[term].postings);
+                cursors[term].Seek(first);
+                postings_total += plus_terms[term].postings->LowerBound(last) - cursors[term].Position();
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+            minus_cursors.resize(minus_postings.size());
+            for (size_t term = 0; term < minus_postings.size(); ++term) {
+                minus_cursors[term].Reset(*minus_postings[term]);
+                minus_cursors[term].Seek(first);
+            }
+
+            TopDocuments& top = chunk_top[chunk];
+            //Запас на погрешность сравнения: документ в пределах COMPARISSON_PRECISION от худшего может обойти его по рейтингу
+            const auto get_threshold = [&top]() {
+                return top.IsFull() ? top.Worst().relevance - 2 * COMPARISSON_PRECISION : -std::numeric_limits<double>::infinity();
+            };
+            for (int window_first = first; window_first < last; window_first += PRUNING_WINDOW) {
+                const int window_last = std::min(last, window_first + PRUNING_WINDOW);
+                accumulator.Prepare(window_first, window_last - window_first);
+
+                double threshold = get_threshold();
+                int non_essential_count = 0;
+                double non_essential_bound = 0;
+                while (non_essential_count < term_count
+                       && non_essential_bound + plus_terms[by_bound[non_essential_count]].upper_bound < threshold) {
+                    non_essential_bound += plus_terms[by_bound[non_essential_count]].upper_bound;
+                    ++non_essential_count;
+                }
+                //Точечный поиск для кандидата много дороже последовательного чтения постинга. Если несущественные
+                //листы в окне ненамного длиннее существенных, выгоднее прочитать их целиком без отсечения
+                if (non_essential_count > 0) {
+                    uint64_t essential_postings = 0;
+                    uint64_t non_essential_postings = 0;
+                    for (int i = 0; i < term_count; ++i) {
+                        const size_t window_postings = plus_terms[by_bound[i]].postings->LowerBound(window_last)
+                                                       - cursors[by_bound[i]].Position();
+                        (i < non_essential_count ? non_essential_postings : essential_postings) += window_postings;
+                    }
+                    if (non_essential_postings <= essential_postings * PRUNING_MIN_SKIP_RATIO) {
+                        non_essential_count = 0;
+                        non_essential_bound = 0;
+                    }
+                }
+
+                for (PostingCursor& cursor : minus_cursors) {
+                    for (; !cursor.AtEnd() && cursor.Ordinal() < window_last; cursor.Next()) {
+                        accumulator.ExcludeByMinusWord(cursor.Ordinal());
+                    }
+                }
+                for (int i = non_essential_count; i < term_count; ++i) {
+                    const double inverse_document_freq = plus_terms[by_bound[i]].inverse_document_freq;
+                    PostingCursor& cursor = cursors[by_bound[i]];
+                    const size_t begin = cursor.Position();
+                    for (; !cursor.AtEnd() && cursor.Ordinal() < window_last; cursor.Next()) {
+                        const int ordinal = cursor.Ordinal();
+                        //Кандидат считается при первой встрече, в том числе если его уже исключило минус-слово
+                        if (accumulator.IsExcluded(ordinal)) {
+                            if (accumulator.TakeMinusExcluded(ordinal)) {
+                                ++minus_word_exclusions;
+                                if constexpr (IS_TRACED) {
+                                    ++counters.candidates;
+                                }
+                            }
+                            continue;
+                        }
+                        //Предикат проверяется один раз при первой встрече документа
+                        if (accumulator.IsFresh(ordinal)) {
+                            const auto& document_data = documents_[ordinal];
+                            if constexpr (IS_TRACED) {
+                                ++counters.candidates;
+                            }
+                            if (document_data.is_removed || !document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                                if constexpr (IS_TRACED) {
+                                    ++counters.predicate_rejected;
+                                }
+                                accumulator.Exclude(ordinal);
+                                continue;
+                            }
+                        }
+                        accumulator.Add(ordinal, cursor.TermFreq() * inverse_document_freq);
+                    }
+                    postings_traversed += cursor.Position() - begin;
+                }
+
+                //Кандидаты по возрастанию номеров, чтобы курсоры несущественных слов двигались только вперёд
+                if (non_essential_count > 0) {
+                    accumulator.SortTouched();
+                }
+                accumulator.ForEachScored([&](int ordinal, double partial_relevance) {
+                    double bound = partial_relevance + non_essential_bound;
+                    for (int i = non_essential_count - 1; i >= 0 && bound >= threshold; --i) {
+                        const PlusTerm& term = plus_terms[by_bound[i]];
+                        PostingCursor& cursor = cursors[by_bound[i]];
+                        bound -= term.upper_bound;
+                        cursor.Seek(ordinal);
+                        ++postings_probed;
+                        if (!cursor.AtEnd() && cursor.Ordinal() == ordinal) {
+                            bound += cursor.TermFreq() * term.inverse_document_freq;
+                        }
+                    }
+                    if (bound < threshold) {
+                        if constexpr (IS_TRACED) {
+                            ++counters.pruned;
+                        }
+                        return;
+                    }
+                    const auto& document_data = documents_[ordinal];
+                    top.Push({document_data.id, ComputeExactRelevance(ordinal, plus_terms), document_data.rating});
+                    ++documents_matched;
+                    threshold = get_threshold();
+                });
+                for (int i = 0; i < non_essential_count; ++i) {
+                    cursors[by_bound[i]].Seek(window_last);
+                }
+                accumulator.Clear();
+            }
+            postings_total_ += postings_total;
+            postings_traversed_ += postings_traversed;
+            postings_probed_ += postings_probed;
+            if (metrics_.postings_scanned != nullptr) {
+                metrics_.postings_scanned->Add(postings_traversed + postings_probed);
+                metrics_.documents_matched->Add(documents_matched);
+                metrics_.minus_word_exclusions->Add(minus_word_exclusions);
+            }
+            if constexpr (IS_TRACED) {
+                counters.postings_total = postings_total;
+                counters.postings_traversed = postings_traversed;
+                counters.postings_probed = postings_probed;
+                counters.minus_excluded = minus_word_exclusions;
+                counters.rescored = documents_matched;
+                chunk_counters[chunk] = counters;
             }
         });
+        if constexpr (IS_TRACED) {
+            trace->AddStage("traverse", stage_start);
+            for (const QueryTrace::Counters& counters : chunk_counters) {
+                trace->counters.postings_total += counters.postings_total;
+                trace->counters.postings_traversed += counters.postings_traversed;
+                trace->counters.postings_probed += counters.postings_probed;
+                trace->counters.minus_excluded += counters.minus_excluded;
+                trace->counters.candidates += counters.candidates;
+                trace->counters.predicate_rejected += counters.predicate_rejected;
+                trace->counters.pruned += counters.pruned;
+                trace->counters.rescored += counters.rescored;
+            }
+        }
 
-        std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        for (int chunk = 1; chunk < chunk_count; ++chunk) {
+            chunk_top[0].Merge(chunk_top[chunk]);
         }
-        return matched_documents;
+        if constexpr (IS_TRACED) {
+            trace->AddStage("merge", stage_start);
+        }
+        return std::move(chunk_top[0]);
     }
 
-    template <typename DocumentPredicate>
-    std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-        return SearchServer::FindAllDocuments(std::execution::seq, query, document_predicate);
+    template <typename Policy>
+    int SearchServer::GetChunkCount(const Policy&, int ordinal_count) const {
+        if constexpr (std::is_same_v<Policy, std::execution::sequenced_policy>) {
+            return 1;
+        } else {
+            const int thread_count = thread_pool_ != nullptr ? thread_pool_->GetConcurrency()
+                                                             : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            return std::clamp(ordinal_count / MIN_DOCUMENTS_PER_CHUNK, 1, thread_count);
+        }
     }
 
+    template <typename Policy, typename Func>
+    void SearchServer::ForEachIndex(const Policy& policy, size_t count, const Func& func) const {
+        if constexpr (std::is_same_v<Policy, std::execution::sequenced_policy>) {
+            for (size_t index = 0; index < count; ++index) {
+                func(index);
+            }
+        } else if (thread_pool_ != nullptr) {
+            thread_pool_->ParallelFor(count, func);
+        } else {
+            const ScratchArena arena;
+            std::pmr::vector<size_t> indexes(count, arena.GetResource());
+            std::iota(indexes.begin(), indexes.end(), 0);
+            std::for_each(policy, indexes.begin(), indexes.end(), func);
+        }
+    }
 
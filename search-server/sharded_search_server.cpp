@@ -0,0 +1,91 @@
+#include "sharded_search_server.h"
+
+ShardedSearchServer::ShardedSearchServer(std::string_view stop_words_text, int shard_count)
+        : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count)
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        using std::literals::string_literals::operator""s;
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    shards_[GetShardIndex(document_id)]->AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    for (const SearchServer::NewDocument& document : documents) {
+        if (document.id < 0) {
+            using std::literals::string_literals::operator""s;
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+    }
+    std::vector<std::vector<SearchServer::NewDocument>> shard_documents(shards_.size());
+    for (const SearchServer::NewDocument& document : documents) {
+        shard_documents[GetShardIndex(document.id)].push_back(document);
+    }
+    //Исключение внутри параллельного алгоритма вызывает std::terminate, поэтому ошибки только запоминаются
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::vector<int> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](int shard_index) {
+        try {
+            shards_[shard_index]->AddDocuments(std::execution::seq, shard_documents[shard_index]);
+        } catch (...) {
+            errors[shard_index] = std::current_exception();
+        }
+    });
+    const auto error = std::find_if(errors.begin(), errors.end(), [](const std::exception_ptr& error) {
+        return error != nullptr;
+    });
+    if (error == errors.end()) {
+        return;
+    }
+    //Шард с ошибкой ничего не добавил, из остальных пакет удаляется
+    for (size_t shard_index = 0; shard_index < shards_.size(); ++shard_index) {
+        if (errors[shard_index] == nullptr && !shard_documents[shard_index].empty()) {
+            std::vector<int> ids;
+            for (const SearchServer::NewDocument& document : shard_documents[shard_index]) {
+                ids.push_back(document.id);
+            }
+            shards_[shard_index]->RemoveDocuments(ids);
+        }
+    }
+    std::rethrow_exception(*error);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_id >= 0) {
+        shards_[GetShardIndex(document_id)]->RemoveDocument(document_id);
+    }
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, int top_count) const {
+    return FindTopDocuments(std::execution::par, raw_query, top_count);
+}
+
+SearchServer::MatchResult ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    if (document_id < 0) {
+        using std::literals::string_literals::operator""s;
+        throw std::out_of_range("No such id"s);
+    }
+    return shards_[GetShardIndex(document_id)]->MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+int ShardedSearchServer::GetShardCount() const {
+    return static_cast<int>(shards_.size());
+}
+
+int ShardedSearchServer::GetShardIndex(int document_id) const {
+    //Мультипликативный хеш: идущие подряд id расходятся по разным шардам равномерно
+    const uint32_t hash = static_cast<uint32_t>(document_id) * 2654435761u;
+    return static_cast<int>((static_cast<uint64_t>(hash) * shards_.size()) >> 32);
+}
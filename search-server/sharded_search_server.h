@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+//Документы распределяются по шардам по хешу id, каждый шард - отдельный SearchServer со своим индексом.
+//Запрос выполняется на всех шардах, лучшие документы шардов сливаются. IDF считается по суммарной
+//статистике всех шардов, поэтому выдача совпадает до бита с выдачей одного SearchServer с теми же документами
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, int shard_count);
+    ShardedSearchServer(std::string_view stop_words_text, int shard_count);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    //Добавляет пакет целиком или, если хотя бы один документ некорректен, не добавляет ничего.
+    //Шарды заполняются параллельно
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    //policy задаёт, опрашиваются ли шарды параллельно
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    //Документ лежит в одном шарде, поэтому запрос уходит только в него
+    SearchServer::MatchResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    int GetShardCount() const;
+
+private:
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+
+    int GetShardIndex(int document_id) const;
+
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsImpl(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                               int top_count) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, int shard_count) {
+    using std::literals::string_literals::operator""s;
+    if (shard_count <= 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (int i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<SearchServer>(stop_words));
+    }
+}
+
+template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                            DocumentPredicate document_predicate, int top_count) const {
+    return FindTopDocumentsImpl(policy, raw_query, document_predicate, top_count);
+}
+
+template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                                            int top_count) const {
+    return FindTopDocumentsImpl(policy, raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    }, top_count);
+}
+
+template <class ExecutionPolicy, IsExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, int top_count) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, top_count);
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocumentsImpl(ExecutionPolicy policy, std::string_view raw_query,
+                                                                DocumentPredicate document_predicate, int top_count) const {
+    //Все шарды созданы с одними стоп-словами и разбирают запрос одинаково. Шаблоны раскрываются
+    //по словарям всех шардов, частота слова при выборе раскрытий - суммарная
+    const SearchServer::ScratchQuery scratch_query;
+    SearchServer::Query& query = *scratch_query;
+    shards_.front()->ParseQuery(raw_query, query, false, false);
+    for (const std::string_view pattern : query.plus_patterns) {
+        query.pattern_terms.clear();
+        for (const auto& shard : shards_) {
+            shard->CollectPatternTerms(pattern, query.pattern_terms);
+        }
+        SearchServer::SelectPatternTerms(query.pattern_terms, MAX_PATTERN_EXPANSIONS, query.plus_words);
+    }
+    for (const std::string_view pattern : query.minus_patterns) {
+        query.pattern_terms.clear();
+        for (const auto& shard : shards_) {
+            shard->CollectPatternTerms(pattern, query.pattern_terms);
+        }
+        SearchServer::SelectPatternTerms(query.pattern_terms, query.pattern_terms.size(), query.minus_words);
+    }
+    SearchServer::RemoveDuplicateWords(query);
+    SearchServer::GlobalTermStats global_stats;
+    global_stats.document_freqs.assign(query.plus_words.size(), 0);
+    for (const auto& shard : shards_) {
+        global_stats.document_count += shard->GetDocumentCount();
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            global_stats.document_freqs[i] += shard->GetDocumentFreq(query.plus_words[i]);
+        }
+    }
+
+    std::vector<TopDocuments> shard_top(shards_.size());
+    std::vector<int> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(policy, shard_indexes.begin(), shard_indexes.end(), [&](int shard_index) {
+        shard_top[shard_index] = shards_[shard_index]->FindTopMatches(std::execution::seq, query, document_predicate, top_count,
+                                                                      &global_stats);
+    });
+    for (size_t i = 1; i < shard_top.size(); ++i) {
+        shard_top[0].Merge(shard_top[i]);
+    }
+    return shard_top[0].ExtractSorted();
+}
@@ -0,0 +1,123 @@
+#include "snapshot.h"
+
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp")
+    , out_(temporary_path_, std::ios::binary | std::ios::trunc) {
+    using std::literals::string_literals::operator""s;
+    if (!out_) {
+        throw std::runtime_error("Cannot open snapshot file "s + temporary_path_);
+    }
+    out_.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    WriteValue(SNAPSHOT_VERSION);
+    WriteValue(SNAPSHOT_BYTE_ORDER_MARK);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!is_finished_) {
+        out_.close();
+        std::error_code error;
+        std::filesystem::remove(temporary_path_, error);
+    }
+}
+
+void SnapshotWriter::Finish() {
+    using std::literals::string_literals::operator""s;
+    out_.flush();
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Cannot write snapshot");
+    }
+    //Переименование заменяет прежний снимок целиком
+    std::error_code error;
+    std::filesystem::rename(temporary_path_, path_, error);
+    if (error) {
+        throw std::runtime_error("Cannot replace snapshot file "s + path_ + ": "s + error.message());
+    }
+    is_finished_ = true;
+}
+
+SnapshotReader::SnapshotReader(const std::string& path) {
+    using std::literals::string_literals::operator""s;
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map snapshot file "s + path);
+        }
+        //Файл читается целиком, страницы подгружаются заранее
+        madvise(data, size_, MADV_WILLNEED);
+        data_ = static_cast<const char*>(data);
+    }
+    //Отображение остаётся валидным и после закрытия дескриптора
+    close(fd);
+#endif
+    try {
+        if (size_ < sizeof(SNAPSHOT_MAGIC) || std::memcmp(Take(sizeof(SNAPSHOT_MAGIC)), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+            throw std::runtime_error("File "s + path + " is not a search server snapshot"s);
+        }
+        if (ReadValue<uint32_t>() != SNAPSHOT_VERSION) {
+            throw std::runtime_error("Unsupported snapshot version"s);
+        }
+        if (ReadValue<uint32_t>() != SNAPSHOT_BYTE_ORDER_MARK) {
+            throw std::runtime_error("Snapshot was written on a platform with another byte order"s);
+        }
+    } catch (...) {
+        //Деструктор недостроенного объекта не вызывается
+        Unmap();
+        throw;
+    }
+}
+
+SnapshotReader::~SnapshotReader() {
+    Unmap();
+}
+
+void SnapshotReader::Unmap() {
+#ifndef _WIN32
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+    }
+#endif
+}
+
+const char* SnapshotReader::Take(size_t size) {
+    if (size > size_ - pos_) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+    const char* data = data_ + pos_;
+    pos_ += size;
+    return data;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+//Формат снимка: заголовок (сигнатура, версия, метка порядка байт), затем поля в порядке записи.
+//Массив - это число элементов uint64 и сами элементы подряд, строки - массив смещений и общий буфер символов.
+//При несовместимом изменении формата SNAPSHOT_VERSION увеличивается, старые снимки не читаются
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 3;
+const uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+
+//Снимок пишется во временный файл path + ".tmp", который Finish переименовывает в path. Если запись
+//прервалась, прежний снимок по пути path остаётся целым, а временный файл удаляется деструктором
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    ~SnapshotWriter();
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    template <typename T>
+    void WriteValue(const T& value);
+    template <typename T>
+    void WriteArray(const T* data, size_t size);
+    template <typename T>
+    void WriteArray(const std::vector<T>& values);
+    template <typename StringContainer>
+    void WriteStrings(const StringContainer& strings);
+
+    //Дописывает буфер на диск и заменяет снимок по пути path, ошибка записи приводит к исключению
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    bool is_finished_ = false;
+};
+
+//Снимок отображается в память через mmap и читается последовательно. Каждый массив копируется из отображения
+//одним memcpy, без разбора по элементам. Постинг-листы хранятся в упакованном виде и при загрузке только
+//проверяются распаковкой, но словарь слов и прямой индекс строятся заново за время, линейное по их размеру.
+//Выход за границу файла означает повреждённый снимок
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& path);
+    ~SnapshotReader();
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    template <typename T>
+    T ReadValue();
+    template <typename T>
+    void ReadArray(std::vector<T>& values);
+    //Вызывает func(std::string_view) для каждой строки, view указывает в отображение и живёт вместе с reader
+    template <typename Func>
+    void ReadStrings(Func func);
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+#ifdef _WIN32
+    std::vector<char> buffer_;
+#endif
+
+    const char* Take(size_t size);
+    void Unmap();
+};
+
+template <typename T>
+void SnapshotWriter::WriteValue(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void SnapshotWriter::WriteArray(const T* data, size_t size) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteValue<uint64_t>(size);
+    out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size * sizeof(T)));
+}
+
+template <typename T>
+void SnapshotWriter::WriteArray(const std::vector<T>& values) {
+    WriteArray(values.data(), values.size());
+}
+
+template <typename StringContainer>
+void SnapshotWriter::WriteStrings(const StringContainer& strings) {
+    std::vector<uint64_t> offsets = {0};
+    std::string chars;
+    for (const auto& str : strings) {
+        chars += str;
+        offsets.push_back(chars.size());
+    }
+    WriteArray(offsets);
+    WriteArray(chars.data(), chars.size());
+}
+
+template <typename T>
+T SnapshotReader::ReadValue() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+}
+
+template <typename T>
+void SnapshotReader::ReadArray(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const uint64_t size = ReadValue<uint64_t>();
+    if (size > size_ / sizeof(T)) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+    const char* data = Take(size * sizeof(T));
+    values.resize(size);
+    if (size > 0) {
+        std::memcpy(values.data(), data, size * sizeof(T));
+    }
+}
+
+template <typename Func>
+void SnapshotReader::ReadStrings(Func func) {
+    std::vector<uint64_t> offsets;
+    ReadArray(offsets);
+    const uint64_t char_count = ReadValue<uint64_t>();
+    const char* chars = Take(char_count);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > char_count) {
+            throw std::runtime_error("Snapshot is corrupted");
+        }
+        func(std::string_view(chars + offsets[i], offsets[i + 1] - offsets[i]));
+    }
+}
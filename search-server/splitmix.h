@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+//Финальное перемешивание splitmix64: каждый бит результата зависит от всех битов value
+inline uint64_t SplitMix64(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
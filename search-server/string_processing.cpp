@@ -1,40 +1,135 @@
 #include "string_processing.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define STRING_PROCESSING_SSE2
+#if defined(__GNUC__)
+#define STRING_PROCESSING_AVX2
+#endif
+#endif
+
 std::vector<std::string> SplitIntoWords(const std::string& text) {
     std::vector<std::string> words;
-    std::string word;
-    for (const char c : text) {
-        if (c == ' ') {
-            if (!word.empty()) {
-                words.push_back(word);
-                word.clear();
-            }
+    ForEachWord(text, [&words](std::string_view word) {
+        words.emplace_back(word);
+    });
+    return words;
+}
+
+std::vector<std::string_view> SplitIntoWords(const std::string_view& str) {
+    std::vector<std::string_view> result;
+    ForEachWord(str, [&result](std::string_view word) {
+        result.push_back(word);
+    });
+    return result;
+}
+
+bool IsWordPattern(std::string_view word) {
+    return word.find_first_of("*?") != std::string_view::npos;
+}
+
+std::string_view GetPatternPrefix(std::string_view pattern) {
+    return pattern.substr(0, pattern.find_first_of("*?"));
+}
+
+namespace {
+
+//Позиция следующей кодовой точки UTF-8: байты продолжения имеют вид 10xxxxxx
+size_t NextCodePoint(std::string_view text, size_t pos) {
+    ++pos;
+    while (pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80) {
+        ++pos;
+    }
+    return pos;
+}
+
+}
+
+bool MatchesPattern(std::string_view pattern, std::string_view word) {
+    //Жадное сопоставление с возвратом к последней '*': она забирает на один символ больше.
+    //'?' и '*' сдвигают позицию в слове на целую кодовую точку, литералы сравниваются побайтово
+    size_t pattern_pos = 0;
+    size_t word_pos = 0;
+    size_t star_pos = std::string_view::npos;
+    size_t star_word_pos = 0;
+    while (word_pos < word.size()) {
+        if (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+            star_pos = pattern_pos++;
+            star_word_pos = word_pos;
+        } else if (pattern_pos < pattern.size() && pattern[pattern_pos] == '?') {
+            ++pattern_pos;
+            word_pos = NextCodePoint(word, word_pos);
+        } else if (pattern_pos < pattern.size() && pattern[pattern_pos] == word[word_pos]) {
+            ++pattern_pos;
+            ++word_pos;
+        } else if (star_pos != std::string_view::npos) {
+            pattern_pos = star_pos + 1;
+            star_word_pos = NextCodePoint(word, star_word_pos);
+            word_pos = star_word_pos;
         } else {
-            word += c;
+            return false;
         }
     }
-    if (!word.empty()) {
-        words.push_back(word);
+    while (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+        ++pattern_pos;
     }
-    return words;
+    return pattern_pos == pattern.size();
 }
 
-std::vector<std::string_view> SplitIntoWords(const std::string_view& str) {
-        auto text = str;
-        std::vector<std::string_view> result;
-        text.remove_prefix(std::min(text.size(), text.find_first_not_of(" ")));
-        //int64_t pos = str.find_first_not_of(" ");
-        const int64_t pos_end = text.npos;
-        int64_t space = text.find(' ');
-        while (space != pos_end) {
-            result.push_back(space == pos_end ? text : text.substr( 0, space));
-            text.remove_prefix(space);
-            text.remove_prefix(std::min(text.size(), text.find_first_not_of(" ")));
-            space = text.find(' ');
-        }
-        if(space == pos_end && text.size() != 0) {
-            result.push_back(text);
-        }
+TextBlockMasks ScanTextBlockScalar(const char* data) {
+    TextBlockMasks masks = {0, 0};
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; ++i) {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        masks.spaces |= static_cast<uint64_t>(c == ' ') << i;
+        masks.controls |= static_cast<uint64_t>(c < ' ') << i;
+    }
+    return masks;
+}
+
+#ifdef STRING_PROCESSING_SSE2
+namespace {
+
+TextBlockMasks ScanTextBlockSse2(const char* data) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(' ' - 1);
+    TextBlockMasks masks = {0, 0};
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 16) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        //Беззнаковое c <= 31 через min: SSE2 умеет сравнивать байты только со знаком
+        const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(chars, last_control), chars);
+        masks.spaces |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, space)))) << i;
+        masks.controls |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(controls))) << i;
+    }
+    return masks;
+}
+
+#ifdef STRING_PROCESSING_AVX2
+__attribute__((target("avx2"))) TextBlockMasks ScanTextBlockAvx2(const char* data) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+    TextBlockMasks masks = {0, 0};
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(chars, last_control), chars);
+        masks.spaces |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, space)))) << i;
+        masks.controls |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(controls))) << i;
+    }
+    return masks;
+}
+#endif
+
+}
+#endif
 
-        return result;
+ScanTextBlockFunction GetScanTextBlockFunction() {
+#ifdef STRING_PROCESSING_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return ScanTextBlockAvx2;
+    }
+#endif
+#ifdef STRING_PROCESSING_SSE2
+    return ScanTextBlockSse2;
+#else
+    return ScanTextBlockScalar;
+#endif
 }
@@ -1,20 +1,117 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <set>
 #include <string_view>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWords(const std::string_view& text);
 
+//Шаблон слова в запросе: '*' - любая, в том числе пустая, последовательность символов, '?' - ровно один символ.
+//Символы считаются кодовыми точками UTF-8, а не байтами
+bool IsWordPattern(std::string_view word);
+//Часть шаблона до первого символа подстановки
+std::string_view GetPatternPrefix(std::string_view pattern);
+bool MatchesPattern(std::string_view pattern, std::string_view word);
+
+//Маски блока из TEXT_BLOCK_SIZE байт: бит i установлен, если байт i - пробел (spaces)
+//или управляющий символ с кодом 0-31 (controls)
+const size_t TEXT_BLOCK_SIZE = 64;
+struct TextBlockMasks {
+    uint64_t spaces;
+    uint64_t controls;
+};
+using ScanTextBlockFunction = TextBlockMasks (*)(const char* data);
+
+//Сканер блока под возможности процессора: AVX2, если он есть, иначе SSE2 или побайтовый.
+//Выбирается один раз при первом вызове
+ScanTextBlockFunction GetScanTextBlockFunction();
+TextBlockMasks ScanTextBlockScalar(const char* data);
+
+inline int CountTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+//Вызывает func(word, is_valid) для каждого слова текста, разделённого пробелами, без выделения памяти.
+//is_valid == false, если в слове есть управляющие символы. Границы слов и управляющие символы
+//ищутся за один проход блоками по TEXT_BLOCK_SIZE байт
+template <typename Func>
+void ForEachCheckedWord(std::string_view text, Func func) {
+    static const ScanTextBlockFunction scan = GetScanTextBlockFunction();
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t word_start = 0;
+    bool in_word = false;
+    bool is_valid = true;
+    for (size_t block_start = 0; block_start < size; block_start += TEXT_BLOCK_SIZE) {
+        TextBlockMasks masks;
+        if (size - block_start >= TEXT_BLOCK_SIZE) {
+            masks = scan(data + block_start);
+        } else {
+            //Хвост дополняется пробелами, чтобы не читать за границей текста
+            char tail[TEXT_BLOCK_SIZE];
+            std::fill(std::copy(data + block_start, data + size, tail), tail + TEXT_BLOCK_SIZE, ' ');
+            masks = scan(tail);
+        }
+        uint64_t remaining = ~uint64_t{0};
+        while (remaining != 0) {
+            if (!in_word) {
+                const uint64_t word_bytes = ~masks.spaces & remaining;
+                if (word_bytes == 0) {
+                    break;
+                }
+                const int pos = CountTrailingZeros(word_bytes);
+                word_start = block_start + pos;
+                in_word = true;
+                is_valid = true;
+                remaining &= ~uint64_t{0} << pos;
+            }
+            const uint64_t spaces = masks.spaces & remaining;
+            if (spaces == 0) {
+                is_valid = is_valid && (masks.controls & remaining) == 0;
+                break;
+            }
+            const int end = CountTrailingZeros(spaces);
+            const uint64_t word_mask = remaining & ~(~uint64_t{0} << end);
+            is_valid = is_valid && (masks.controls & word_mask) == 0;
+            func(text.substr(word_start, block_start + end - word_start), is_valid);
+            in_word = false;
+            remaining &= ~uint64_t{0} << end;
+        }
+    }
+    if (in_word) {
+        func(text.substr(word_start), is_valid);
+    }
+}
+
+//Вызывает func(word) для каждого слова текста, разделённого пробелами, без выделения памяти
+template <typename Func>
+void ForEachWord(std::string_view text, Func func) {
+    ForEachCheckedWord(text, [&func](std::string_view word, bool) {
+        func(word);
+    });
+}
+
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
-    for (const std::string& str : strings) {
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
+    for (const auto& str : strings) {
         if (!str.empty()) {
-            non_empty_strings.insert(str);
+            non_empty_strings.emplace(str);
         }
     }
     return non_empty_strings;
@@ -0,0 +1,105 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+int TermDictionary::Intern(std::string_view word) {
+    if (slots_.empty() || (terms_.size() + 1) * 2 > slots_.size()) {
+        Rehash();
+    }
+    const size_t slot = FindSlot(word);
+    if (slots_[slot] != NO_TERM) {
+        return slots_[slot];
+    }
+    const int term_id = static_cast<int>(terms_.size());
+    terms_.push_back(Store(word));
+    slots_[slot] = term_id;
+    AddToSortedRuns(term_id);
+    return term_id;
+}
+
+int TermDictionary::Find(std::string_view word) const {
+    return slots_.empty() ? NO_TERM : slots_[FindSlot(word)];
+}
+
+std::vector<int> TermDictionary::GetSortedIds() const {
+    std::vector<int> sorted_ids;
+    sorted_ids.reserve(terms_.size());
+    for (const std::vector<int>& run : sorted_runs_) {
+        const size_t middle = sorted_ids.size();
+        sorted_ids.insert(sorted_ids.end(), run.begin(), run.end());
+        std::inplace_merge(sorted_ids.begin(), sorted_ids.begin() + middle, sorted_ids.end(), [this](int lhs, int rhs) {
+            return terms_[lhs] < terms_[rhs];
+        });
+    }
+    return sorted_ids;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    size_t bytes = block_bytes_ + terms_.capacity() * sizeof(std::string_view) + slots_.capacity() * sizeof(int);
+    for (const std::vector<int>& run : sorted_runs_) {
+        bytes += run.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+std::string_view TermDictionary::Store(std::string_view word) {
+    //Пустому слову блок не нужен, а пустого словаря blocks_.back() не существует
+    if (word.empty()) {
+        return std::string_view();
+    }
+    //Длинное слово получает отдельный блок, текущий блок продолжает заполняться
+    if (word.size() > BLOCK_SIZE / 4) {
+        auto block = std::make_unique<char[]>(word.size());
+        block_bytes_ += word.size();
+        std::memcpy(block.get(), word.data(), word.size());
+        const std::string_view stored(block.get(), word.size());
+        blocks_.insert(blocks_.end() - (blocks_.empty() ? 0 : 1), std::move(block));
+        return stored;
+    }
+    if (word.size() > block_free_) {
+        blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        block_bytes_ += BLOCK_SIZE;
+        block_free_ = BLOCK_SIZE;
+    }
+    char* data = blocks_.back().get() + (BLOCK_SIZE - block_free_);
+    std::memcpy(data, word.data(), word.size());
+    block_free_ -= word.size();
+    return std::string_view(data, word.size());
+}
+
+size_t TermDictionary::FindSlot(std::string_view word) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(word) & mask;
+    while (slots_[slot] != NO_TERM && terms_[slots_[slot]] != word) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void TermDictionary::Rehash() {
+    slots_.assign(std::max<size_t>(16, slots_.size() * 2), NO_TERM);
+    const size_t mask = slots_.size() - 1;
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        size_t slot = std::hash<std::string_view>{}(terms_[term_id]) & mask;
+        while (slots_[slot] != NO_TERM) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<int>(term_id);
+    }
+}
+
+void TermDictionary::AddToSortedRuns(int term_id) {
+    sorted_runs_.push_back({term_id});
+    while (sorted_runs_.size() >= 2 && sorted_runs_[sorted_runs_.size() - 2].size() <= sorted_runs_.back().size()) {
+        std::vector<int>& previous = sorted_runs_[sorted_runs_.size() - 2];
+        const std::vector<int>& last = sorted_runs_.back();
+        std::vector<int> merged(previous.size() + last.size());
+        std::merge(previous.begin(), previous.end(), last.begin(), last.end(), merged.begin(), [this](int lhs, int rhs) {
+            return terms_[lhs] < terms_[rhs];
+        });
+        previous = std::move(merged);
+        sorted_runs_.pop_back();
+    }
+}
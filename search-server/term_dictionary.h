@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+//Словарь слов с плотными идентификаторами в порядке добавления. Текст слов лежит подряд в блоках,
+//которые не перемещаются, поэтому string_view на слова валидны всё время жизни словаря.
+//Точный поиск идёт по хеш-таблице идентификаторов с открытой адресацией, поиск по префиксу - по отсортированным
+//сериям идентификаторов. Новое слово образует серию из одного элемента, последние серии сливаются, пока
+//предыдущая не длиннее следующей: серий O(log n), вставка в них стоит O(log n) сравнений амортизированно
+class TermDictionary {
+public:
+    static constexpr int NO_TERM = -1;
+
+    int Intern(std::string_view word);
+    int Find(std::string_view word) const;
+    std::string_view GetTerm(int term_id) const {
+        return terms_[term_id];
+    }
+    size_t size() const {
+        return terms_.size();
+    }
+
+    //Слова в порядке идентификаторов
+    auto begin() const {
+        return terms_.begin();
+    }
+    auto end() const {
+        return terms_.end();
+    }
+
+    //Вызывает func(term_id) для каждого слова, начинающегося с prefix. Порядок вызовов не определён
+    template <typename Func>
+    void ForEachWithPrefix(std::string_view prefix, Func func) const;
+
+    //Идентификаторы по возрастанию слов
+    std::vector<int> GetSortedIds() const;
+
+    //Байты блоков текста, ссылок на слова, хеш-таблицы и серий вместе с резервом
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_free_ = 0; //Свободные байты в последнем блоке
+    size_t block_bytes_ = 0;
+    std::vector<std::string_view> terms_;
+    std::vector<int> slots_; //NO_TERM или идентификатор, размер - степень двойки
+    std::vector<std::vector<int>> sorted_runs_; //По убыванию длины
+
+    std::string_view Store(std::string_view word);
+    //Ячейка со словом word или первая пустая ячейка на его пути
+    size_t FindSlot(std::string_view word) const;
+    void Rehash();
+    void AddToSortedRuns(int term_id);
+};
+
+template <typename Func>
+void TermDictionary::ForEachWithPrefix(std::string_view prefix, Func func) const {
+    for (const std::vector<int>& run : sorted_runs_) {
+        auto it = std::lower_bound(run.begin(), run.end(), prefix, [this](int term_id, std::string_view value) {
+            return terms_[term_id] < value;
+        });
+        for (; it != run.end() && terms_[*it].substr(0, prefix.size()) == prefix; ++it) {
+            func(*it);
+        }
+    }
+}
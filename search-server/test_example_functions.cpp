@@ -354,6 +354,1372 @@ void TestFindByStatus() {
     }
 }
 
+//Тест проверяет удаление документов из индекса
+void TestRemoveDocument() {
+    using namespace std::literals;
+    const std::vector<std::string> content = {"cat in the city"s,
+                                    "cat in the city eats cat food and does other stuff cat do"s,
+                                    "cat cat cat food food food"s};
+    {
+        SearchServer server(""s);
+        for(int i = 0; i < 3; ++i) {
+            server.AddDocument(i, content[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        server.RemoveDocument(1);
+        ASSERT_EQUAL(server.GetDocumentCount(), 2);
+        const auto result = server.FindTopDocuments("cat food"s);
+        ASSERT_EQUAL_HINT(result.size(), 2u, "Removed document must not be found"s);
+        ASSERT_EQUAL(result[0].id, 2);
+        ASSERT_EQUAL(result[1].id, 0);
+        ASSERT_HINT(server.FindTopDocuments("eats"s).empty(), "Postings of removed document must be erased"s);
+        ASSERT_HINT(server.GetWordFrequencies(1).empty(), "Word frequencies of removed document must be erased"s);
+        //Повторное удаление и удаление несуществующего документа ничего не делают
+        server.RemoveDocument(1);
+        server.RemoveDocument(42);
+        ASSERT_EQUAL(server.GetDocumentCount(), 2);
+    }
+    //Параллельная версия ведёт себя так же
+    {
+        SearchServer server(""s);
+        for(int i = 0; i < 3; ++i) {
+            server.AddDocument(i, content[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        server.RemoveDocument(std::execution::par, 2);
+        const auto result = server.FindTopDocuments("food"s);
+        ASSERT_EQUAL(result.size(), 1u);
+        ASSERT_EQUAL(result[0].id, 1);
+        //Идентификатор после удаления можно использовать снова
+        server.AddDocument(2, "dog"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 1u);
+        const auto [words, status] = server.MatchDocument("cat food"s, 1);
+        const std::vector<std::string_view> expected_words = {"cat"sv, "food"sv};
+        ASSERT_EQUAL(words, expected_words);
+    }
+}
+
+//Тест проверяет ограничение размера выдачи
+void TestTopCount() {
+    using namespace std::literals;
+    SearchServer server(""s);
+    for(int i = 0; i < 8; ++i) {
+        //Чем больше id, тем выше TF слова cat и релевантность
+        std::string content = "cat"s;
+        for(int j = i; j < 8; ++j) {
+            content += " dog"s;
+        }
+        server.AddDocument(i, content, DocumentStatus::ACTUAL, {i});
+    }
+    server.AddDocument(8, "bird"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL_HINT(server.FindTopDocuments("cat"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT),
+                      "Default result size must be MAX_RESULT_DOCUMENT_COUNT"s);
+    {
+        const auto result = server.FindTopDocuments("cat"s, 2);
+        ASSERT_EQUAL(result.size(), 2u);
+        ASSERT_EQUAL(result[0].id, 7);
+        ASSERT_EQUAL(result[1].id, 6);
+    }
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "cat"s, DocumentStatus::ACTUAL, 100).size(), 8u);
+    ASSERT_HINT(server.FindTopDocuments("cat"s, 0).empty(), "Zero top_count must return nothing"s);
+    //При равной релевантности порядок определяется рейтингом, затем id
+    {
+        SearchServer equal_server(""s);
+        equal_server.AddDocument(3, "cat"s, DocumentStatus::ACTUAL, {1});
+        equal_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+        equal_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, {5});
+        equal_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {5});
+        const auto result = equal_server.FindTopDocuments("cat"s, 2);
+        ASSERT_EQUAL(result.size(), 2u);
+        ASSERT_EQUAL(result[0].id, 2);
+        ASSERT_EQUAL(result[1].id, 1);
+    }
+}
+
+//Тест проверяет, что отсечение MaxScore не меняет выдачу по сравнению с полным перебором
+void TestPruning() {
+    using namespace std::literals;
+    //Слова с номером i встречаются с частотой ~1/(i+1), как в естественном тексте
+    std::mt19937 generator(42);
+    std::vector<std::string> dictionary;
+    for(int i = 0; i < 300; ++i) {
+        dictionary.push_back("w"s + std::to_string(i));
+    }
+    std::vector<double> weights;
+    for(size_t i = 0; i < dictionary.size(); ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    std::discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    const auto generate_text = [&](int word_count) {
+        std::string text;
+        for(int i = 0; i < word_count; ++i) {
+            text += dictionary[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+
+    SearchServer server(""s);
+    for(int id = 0; id < 20000; ++id) {
+        server.AddDocument(id, generate_text(30), static_cast<DocumentStatus>(id % 3 == 0), {id % 7, id % 5});
+    }
+    for(int id = 0; id < 20000; id += 4) {
+        server.RemoveDocument(id);
+    }
+    server.ResetPruningStats();
+    for(int i = 0; i < 200; ++i) {
+        const std::string query = generate_text(6) + (i % 4 == 0 ? "-"s + dictionary[i % 50] : ""s);
+        const auto exhaustive = server.FindTopDocuments(query, std::numeric_limits<int>::max());
+        for(const int top_count : {1, 5, 20}) {
+            const auto pruned = server.FindTopDocuments(query, top_count);
+            ASSERT_EQUAL(pruned.size(), std::min(exhaustive.size(), static_cast<size_t>(top_count)));
+            for(size_t j = 0; j < pruned.size(); ++j) {
+                ASSERT_EQUAL_HINT(pruned[j].id, exhaustive[j].id, "Pruning changed the result for query: "s + query);
+                ASSERT_HINT(pruned[j].relevance == exhaustive[j].relevance, "Pruning changed relevance for query: "s + query);
+            }
+        }
+    }
+    const auto stats = server.GetPruningStats();
+    ASSERT_HINT(stats.postings_traversed < stats.postings_total, "Skewed queries must skip some postings"s);
+}
+
+//Тест проверяет, что закешированный IDF пересчитывается после изменения набора документов
+void TestInverseDocumentFreqUpdates() {
+    using namespace std::literals;
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "bird"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(std::abs(server.FindTopDocuments("cat"s)[0].relevance - 0.5 * log(2.0)) < COMPARISON_PRECISION);
+    server.AddDocument(3, "fish"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_HINT(std::abs(server.FindTopDocuments("cat"s)[0].relevance - 0.5 * log(3.0)) < COMPARISON_PRECISION,
+                "IDF must change with document count"s);
+    //Количество документов прежнее, но слово cat встречается уже в двух из них
+    server.RemoveDocument(3);
+    server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, {1});
+    const auto result = server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(result.size(), 2u);
+    ASSERT_HINT(std::abs(result[0].relevance - log(1.5)) < COMPARISON_PRECISION, "IDF must change with document frequency"s);
+}
+
+//Тест проверяет пакетное добавление документов
+void TestAddDocuments() {
+    using namespace std::literals;
+    const std::vector<std::string> content = {"cat in the city"s,
+                                    "cat in the city eats cat food and does other stuff cat do"s,
+                                    "cat cat cat food food food"s};
+    //Пакет индексируется так же, как документы, добавленные по одному
+    {
+        SearchServer single_server("in the"s);
+        SearchServer batch_server("in the"s);
+        std::vector<SearchServer::NewDocument> batch;
+        for(int i = 0; i < 3; ++i) {
+            single_server.AddDocument(i, content[i], DocumentStatus::ACTUAL, {i, 2});
+            batch.push_back({i, content[i], DocumentStatus::ACTUAL, {i, 2}});
+        }
+        batch_server.AddDocuments(std::execution::par, batch);
+        ASSERT_EQUAL(batch_server.GetDocumentCount(), 3);
+        const auto expected = single_server.FindTopDocuments("cat city food"s);
+        const auto result = batch_server.FindTopDocuments("cat city food"s);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for(size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+            ASSERT_HINT(result[i].relevance == expected[i].relevance, "Batch indexing must produce the same TF"s);
+            ASSERT_EQUAL(result[i].rating, expected[i].rating);
+        }
+        ASSERT_EQUAL(batch_server.GetWordFrequencies(1), single_server.GetWordFrequencies(1));
+    }
+    //Пакет с некорректным документом не добавляется целиком
+    {
+        SearchServer server(""s);
+        server.AddDocument(5, "dog"s, DocumentStatus::ACTUAL, {1});
+        const std::vector<std::vector<SearchServer::NewDocument>> invalid_batches = {
+            {{1, "cat"sv, DocumentStatus::ACTUAL, {1}}, {2, "bad\x12word"sv, DocumentStatus::ACTUAL, {1}}},
+            {{1, "cat"sv, DocumentStatus::ACTUAL, {1}}, {1, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+            {{1, "cat"sv, DocumentStatus::ACTUAL, {1}}, {5, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+            {{-1, "cat"sv, DocumentStatus::ACTUAL, {1}}},
+        };
+        for(const auto& batch : invalid_batches) {
+            try {
+                server.AddDocuments(std::execution::par, batch);
+                ASSERT_HINT(false, "Invalid batch must throw invalid_argument"s);
+            } catch (const std::invalid_argument&) {
+            }
+            ASSERT_EQUAL(server.GetDocumentCount(), 1);
+            ASSERT_HINT(server.FindTopDocuments("cat"s).empty(), "Invalid batch must not change the index"s);
+        }
+    }
+}
+
+//Тест проверяет пакетное удаление и уплотнение индекса
+void TestRemoveDocuments() {
+    using namespace std::literals;
+    std::mt19937 generator(7);
+    const std::vector<std::string> words = {"cat"s, "dog"s, "bird"s, "fish"s, "city"s, "food"s, "tail"s, "ear"s};
+    std::vector<std::string> texts;
+    for(int i = 0; i < 100; ++i) {
+        std::string text;
+        for(int j = 0; j < 6; ++j) {
+            text += words[std::uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        texts.push_back(text);
+    }
+    //Удалённые документы не влияют на выдачу ни до, ни после уплотнения
+    const auto check = [&texts](const SearchServer& server, int first_live_id) {
+        SearchServer expected_server(""s);
+        for(int i = first_live_id; i < static_cast<int>(texts.size()); ++i) {
+            expected_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {i});
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for(const std::string& query : {"cat dog"s, "fish -bird"s, "city food tail ear"s}) {
+            const auto expected = expected_server.FindTopDocuments(query, 1000);
+            const auto result = server.FindTopDocuments(query, 1000);
+            ASSERT_EQUAL(result.size(), expected.size());
+            for(size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL(result[i].id, expected[i].id);
+                ASSERT_HINT(result[i].relevance == expected[i].relevance, "Removed documents must not affect IDF"s);
+            }
+        }
+    };
+    SearchServer server(""s);
+    for(int i = 0; i < static_cast<int>(texts.size()); ++i) {
+        server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {i});
+    }
+    server.RemoveDocuments({0, 1, 2, 3, 4, 1000});
+    try {
+        server.MatchDocument("cat"s, 0);
+        ASSERT_HINT(false, "Removed document must not be matched"s);
+    } catch (const std::out_of_range&) {
+    }
+    check(server, 5);
+    server.RemoveDocuments({5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29});
+    check(server, 30);
+    server.CompactIndex();
+    check(server, 30);
+    //После уплотнения добавление и удаление работают как обычно
+    server.AddDocument(1000, "cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("cat"s, 1000)).size(), 1u);
+    server.RemoveDocument(1000);
+    check(server, 30);
+}
+
+//Тест проверяет сохранение и загрузку снимка индекса
+void TestSnapshot() {
+    using namespace std::literals;
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot"s).string();
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    server.AddDocument(2, "cat eats cat food and does other stuff"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(3, "dog food"s, DocumentStatus::BANNED, {-1});
+    server.AddDocument(4, "city bird"s, DocumentStatus::ACTUAL, {2});
+    server.RemoveDocument(4);
+    server.SaveSnapshot(path);
+    //Повторное сохранение заменяет снимок и не оставляет временный файл
+    server.SaveSnapshot(path);
+    ASSERT_HINT(!std::filesystem::exists(path + ".tmp"s), "Temporary snapshot file must be renamed"s);
+    {
+        const SearchServer loaded = SearchServer::LoadSnapshot(path);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), server.GetDocumentCount());
+        ASSERT_EQUAL(std::vector<int>(loaded.begin(), loaded.end()), std::vector<int>(server.begin(), server.end()));
+        for(const std::string& query : {"cat food"s, "city -food"s, "bird"s, "the cat"s}) {
+            for(const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto expected = server.FindTopDocuments(query, status);
+                const auto result = loaded.FindTopDocuments(query, status);
+                ASSERT_EQUAL(result.size(), expected.size());
+                for(size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL(result[i].id, expected[i].id);
+                    ASSERT_HINT(result[i].relevance == expected[i].relevance, "Snapshot must restore TF and IDF exactly"s);
+                    ASSERT_EQUAL(result[i].rating, expected[i].rating);
+                }
+            }
+        }
+        ASSERT_EQUAL(loaded.GetWordFrequencies(2), server.GetWordFrequencies(2));
+        ASSERT_HINT(loaded.GetWordFrequencies(4).empty(), "Removed document must stay removed"s);
+        const auto [words, status] = loaded.MatchDocument("food dog and"s, 3);
+        ASSERT_EQUAL(words, std::vector<std::string_view>({"dog"sv, "food"sv}));
+        ASSERT_EQUAL(status, DocumentStatus::BANNED);
+    }
+    //Загруженный сервер можно менять дальше
+    {
+        SearchServer loaded = SearchServer::LoadSnapshot(path);
+        loaded.AddDocument(4, "bird in the sky"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(loaded.FindTopDocuments("bird"s).size(), 1u);
+        ASSERT_HINT(loaded.FindTopDocuments("in"s).empty(), "Stop words must be restored"s);
+    }
+    //Листы из нескольких упакованных блоков восстанавливаются без перепаковки
+    {
+        SearchServer large_server(""s);
+        for(int id = 0; id < 1000; ++id) {
+            large_server.AddDocument(id, "common w"s + std::to_string(id % 7) + (id % 300 == 0 ? " rare"s : ""s), DocumentStatus::ACTUAL, {id});
+        }
+        large_server.SaveSnapshot(path);
+        const SearchServer loaded = SearchServer::LoadSnapshot(path);
+        for(const std::string& query : {"common"s, "w3 rare"s, "w5 -w5"s}) {
+            const auto expected = large_server.FindTopDocuments(query, 1000);
+            const auto result = loaded.FindTopDocuments(query, 1000);
+            ASSERT_EQUAL(result.size(), expected.size());
+            for(size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL(result[i].id, expected[i].id);
+                ASSERT(result[i].relevance == expected[i].relevance);
+            }
+        }
+        server.SaveSnapshot(path);
+    }
+    //Обрезанный файл не загружается
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+    try {
+        SearchServer::LoadSnapshot(path);
+        ASSERT_HINT(false, "Truncated snapshot must throw runtime_error"s);
+    } catch (const std::runtime_error&) {
+    }
+    std::filesystem::remove(path);
+}
+
+//Тест проверяет, что снимок с номерами документов, словами или статусами вне допустимых значений не загружается
+void TestCorruptedSnapshot() {
+    using namespace std::literals;
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_corrupted_test.snapshot"s).string();
+    //Поля снимка документов 7 "cat dog" и 8 "cat" в формате SaveSnapshot. Листы короче блока, номера лежат в хвостах
+    struct Fields {
+        std::vector<std::string> terms = {"cat"s, "dog"s};
+        std::vector<int32_t> document_freqs = {2, 1};
+        std::vector<int32_t> tail_ordinals = {0, 1, 0};
+        std::vector<uint16_t> term_freqs = {32768, 65535, 32768};
+        std::vector<int32_t> ids = {7, 8};
+        std::vector<int32_t> statuses = {0, 0};
+        std::vector<int32_t> forward_term_ids = {0, 1, 0};
+        uint64_t posting_count = 3;
+        uint64_t dead_posting_count = 0;
+    };
+    const auto write_snapshot = [&path](const Fields& fields) {
+        SnapshotWriter writer(path);
+        writer.WriteStrings(std::vector<std::string>());
+        writer.WriteStrings(fields.terms);
+        writer.WriteArray(std::vector<int32_t>({0, 1}));
+        writer.WriteArray(fields.document_freqs);
+        writer.WriteArray(std::vector<uint64_t>({0, 2, 3}));
+        writer.WriteArray(std::vector<int32_t>());
+        writer.WriteArray(std::vector<uint32_t>({0, 0}));
+        writer.WriteArray(std::vector<uint32_t>());
+        writer.WriteArray(fields.tail_ordinals);
+        writer.WriteArray(fields.term_freqs);
+        writer.WriteArray(fields.ids);
+        writer.WriteArray(std::vector<int32_t>({3, 4}));
+        writer.WriteArray(fields.statuses);
+        writer.WriteArray(std::vector<uint8_t>({0, 0}));
+        writer.WriteArray(std::vector<uint64_t>({0, 2, 3}));
+        writer.WriteArray(fields.forward_term_ids);
+        writer.WriteArray(std::vector<double>({0.5, 0.5, 1.0}));
+        writer.WriteValue<uint64_t>(fields.posting_count);
+        writer.WriteValue<uint64_t>(fields.dead_posting_count);
+        writer.Finish();
+    };
+    write_snapshot(Fields());
+    {
+        const SearchServer loaded = SearchServer::LoadSnapshot(path);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), 2);
+        ASSERT_EQUAL(loaded.FindTopDocuments("dog"s).size(), 1u);
+        ASSERT_EQUAL(loaded.FindTopDocuments("dog"s)[0].id, 7);
+    }
+    using Corruption = void (*)(Fields&);
+    const std::vector<std::pair<Corruption, std::string>> corruptions = {
+        {[](Fields& fields) { fields.tail_ordinals = {0, 2, 0}; }, "Posting ordinal past the last document"s},
+        {[](Fields& fields) { fields.tail_ordinals = {-1, 1, 0}; }, "Negative posting ordinal"s},
+        {[](Fields& fields) { fields.forward_term_ids = {0, 2, 0}; }, "Forward term id past the dictionary"s},
+        {[](Fields& fields) { fields.forward_term_ids = {0, -1, 0}; }, "Negative forward term id"s},
+        {[](Fields& fields) { fields.statuses = {0, 4}; }, "Status past DocumentStatus::REMOVED"s},
+        {[](Fields& fields) { fields.statuses = {-1, 0}; }, "Negative status"s},
+        {[](Fields& fields) { fields.terms = {""s, "dog"s}; }, "Empty term"s},
+        {[](Fields& fields) { fields.ids = {7, 7}; }, "Live document id at two ordinals"s},
+        {[](Fields& fields) { fields.document_freqs = {-3, 1}; }, "Negative document_freq"s},
+        {[](Fields& fields) { fields.document_freqs = {2, 2}; }, "document_freq above the live postings"s},
+        {[](Fields& fields) { fields.posting_count = 4; }, "Posting count differs from the lists"s},
+        {[](Fields& fields) { fields.dead_posting_count = 1; }, "Dead posting count differs from the lists"s},
+        {[](Fields& fields) { fields.term_freqs = {32768, 0, 32768}; }, "Quantized TF of zero"s},
+    };
+    for(const auto& [corrupt, hint] : corruptions) {
+        Fields fields;
+        corrupt(fields);
+        write_snapshot(fields);
+        try {
+            SearchServer::LoadSnapshot(path);
+            ASSERT_HINT(false, hint + " must throw runtime_error"s);
+        } catch (const std::runtime_error&) {
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+//Тест проверяет сжатый постинг-лист на разных ширинах разностей номеров
+void TestPostingList() {
+    using namespace std::literals;
+    std::mt19937 generator(11);
+    for(const int max_gap : {1, 2, 100, 70000, 1 << 22}) {
+        PostingList postings;
+        std::vector<int> ordinals;
+        std::vector<double> term_freqs;
+        int ordinal = -1;
+        //Неполный последний блок хранится отдельно от упакованных
+        for(int i = 0; i < 3 * PostingList::BLOCK_SIZE + 17; ++i) {
+            ordinal += std::uniform_int_distribution(1, max_gap)(generator);
+            ordinals.push_back(ordinal);
+            term_freqs.push_back(std::uniform_real_distribution(0.001, 1.0)(generator));
+            postings.Append(ordinal, term_freqs.back());
+        }
+        ASSERT_EQUAL(postings.size(), ordinals.size());
+        PostingCursor cursor;
+        cursor.Reset(postings);
+        for(size_t pos = 0; pos < ordinals.size(); ++pos, cursor.Next()) {
+            ASSERT(!cursor.AtEnd());
+            ASSERT_EQUAL(cursor.Ordinal(), ordinals[pos]);
+            ASSERT_EQUAL(cursor.Position(), pos);
+            ASSERT_HINT(cursor.TermFreq() >= term_freqs[pos] && cursor.TermFreq() - term_freqs[pos] < 1e-4,
+                        "Quantized TF must be a close upper bound"s);
+            ASSERT_EQUAL(postings.Find(ordinals[pos]), static_cast<int>(pos));
+        }
+        ASSERT(cursor.AtEnd());
+        for(int probe = 0; probe < 200; ++probe) {
+            const int target = std::uniform_int_distribution(0, ordinals.back() + 1)(generator);
+            const size_t expected = std::lower_bound(ordinals.begin(), ordinals.end(), target) - ordinals.begin();
+            ASSERT_EQUAL(postings.LowerBound(target), expected);
+            if(std::binary_search(ordinals.begin(), ordinals.end(), target)) {
+                ASSERT_EQUAL(postings.Find(target), static_cast<int>(expected));
+            } else {
+                ASSERT_EQUAL(postings.Find(target), -1);
+            }
+        }
+        //Курсор двигается вперёд по возрастающим номерам и останавливается в конце листа
+        cursor.Reset(postings);
+        for(int target = 0; target <= ordinals.back() + 1; target += std::max(1, max_gap * 7)) {
+            cursor.Seek(target);
+            const size_t expected = std::lower_bound(ordinals.begin(), ordinals.end(), target) - ordinals.begin();
+            ASSERT_EQUAL(cursor.Position(), expected);
+            ASSERT_EQUAL(cursor.AtEnd(), expected == ordinals.size());
+        }
+        cursor.Seek(ordinals.back() + 1);
+        ASSERT(cursor.AtEnd());
+        ASSERT_EQUAL(cursor.Position(), ordinals.size());
+    }
+}
+
+//Тест проверяет блочный токенизатор: границы слов на стыках блоков и поиск управляющих символов
+void TestTokenizer() {
+    using namespace std::literals;
+    std::mt19937 generator(5);
+    const std::string alphabet = "  ab-\x01\x1f\x80\xff"s;
+    const ScanTextBlockFunction scan = GetScanTextBlockFunction();
+    for(int i = 0; i < 2000; ++i) {
+        std::string text;
+        const int length = std::uniform_int_distribution(0, 300)(generator);
+        for(int j = 0; j < length; ++j) {
+            text += alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)];
+        }
+        std::vector<std::pair<std::string, bool>> expected;
+        std::string word;
+        bool is_valid = true;
+        for(const char c : text + " "s) {
+            if(c == ' ') {
+                if(!word.empty()) {
+                    expected.emplace_back(word, is_valid);
+                }
+                word.clear();
+                is_valid = true;
+            } else {
+                word += c;
+                is_valid = is_valid && !(c >= '\0' && c < ' ');
+            }
+        }
+        std::vector<std::pair<std::string, bool>> result;
+        ForEachCheckedWord(text, [&result](std::string_view word, bool is_valid) {
+            result.emplace_back(std::string(word), is_valid);
+        });
+        ASSERT_HINT(result == expected, "Tokenizer must match the byte-by-byte split"s);
+        if(text.size() >= TEXT_BLOCK_SIZE) {
+            const TextBlockMasks masks = scan(text.data());
+            const TextBlockMasks scalar_masks = ScanTextBlockScalar(text.data());
+            ASSERT_EQUAL(masks.spaces, scalar_masks.spaces);
+            ASSERT_EQUAL(masks.controls, scalar_masks.controls);
+        }
+    }
+}
+
+//Тест проверяет, что шардированный сервер выдаёт то же, что один сервер с теми же документами
+void TestShardedSearchServer() {
+    using namespace std::literals;
+    std::mt19937 generator(3);
+    std::vector<std::string> dictionary;
+    for(int i = 0; i < 200; ++i) {
+        dictionary.push_back("w"s + std::to_string(i));
+    }
+    std::vector<double> weights;
+    for(size_t i = 0; i < dictionary.size(); ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    std::discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    const auto generate_text = [&](int word_count) {
+        std::string text;
+        for(int i = 0; i < word_count; ++i) {
+            text += dictionary[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+    std::vector<std::string> texts;
+    for(int id = 0; id < 3000; ++id) {
+        texts.push_back(generate_text(20));
+    }
+    std::vector<std::string> queries;
+    for(int i = 0; i < 100; ++i) {
+        queries.push_back(generate_text(4) + (i % 3 == 0 ? "-"s + dictionary[i % 20] : ""s));
+    }
+    //Шаблоны раскрываются по словарям всех шардов
+    //Раскрытие может повторить слово запроса, повтор учитывается один раз
+    for(const std::string& query : {"w1*"s, "w?5 w3"s, "w*7 -w1?"s, "w2 -w*0"s, "w2 w2*"s, "w3* w35 w3? -w4 -w4*"s}) {
+        queries.push_back(query);
+    }
+
+    for(const int shard_count : {1, 3, 8}) {
+        SearchServer server("w1"s);
+        ShardedSearchServer sharded_server("w1"sv, shard_count);
+        std::vector<SearchServer::NewDocument> batch;
+        for(int id = 0; id < static_cast<int>(texts.size()); ++id) {
+            const DocumentStatus status = static_cast<DocumentStatus>(id % 5 == 0);
+            server.AddDocument(id, texts[id], status, {id % 7});
+            if(id % 2 == 0) {
+                sharded_server.AddDocument(id, texts[id], status, {id % 7});
+            } else {
+                batch.push_back({id, texts[id], status, {id % 7}});
+            }
+        }
+        sharded_server.AddDocuments(batch);
+        for(int id = 0; id < static_cast<int>(texts.size()); id += 7) {
+            server.RemoveDocument(id);
+            sharded_server.RemoveDocument(id);
+        }
+        ASSERT_EQUAL(sharded_server.GetShardCount(), shard_count);
+        ASSERT_EQUAL(sharded_server.GetDocumentCount(), server.GetDocumentCount());
+        for(const std::string& query : queries) {
+            for(const int top_count : {5, 1000}) {
+                const auto expected = server.FindTopDocuments(query, top_count);
+                const auto result = sharded_server.FindTopDocuments(std::execution::par, query, top_count);
+                ASSERT_EQUAL(result.size(), expected.size());
+                for(size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result[i].id, expected[i].id, "Sharding changed the result for query: "s + query);
+                    ASSERT_HINT(result[i].relevance == expected[i].relevance, "Sharding must use global IDF"s);
+                    ASSERT_EQUAL(result[i].rating, expected[i].rating);
+                }
+            }
+            const auto banned = sharded_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::BANNED);
+            ASSERT_EQUAL(banned.size(), server.FindTopDocuments(query, DocumentStatus::BANNED).size());
+            ASSERT(sharded_server.MatchDocument(query, 1) == server.MatchDocument(query, 1));
+        }
+        //Пакет с некорректным документом не добавляется ни в один шард
+        const std::vector<SearchServer::NewDocument> invalid_batch = {{5000, "cat"sv, DocumentStatus::ACTUAL, {1}},
+                                                                      {5001, "dog"sv, DocumentStatus::ACTUAL, {1}},
+                                                                      {1, "bird"sv, DocumentStatus::ACTUAL, {1}}};
+        try {
+            sharded_server.AddDocuments(invalid_batch);
+            ASSERT_HINT(false, "Invalid batch must throw invalid_argument"s);
+        } catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(sharded_server.GetDocumentCount(), server.GetDocumentCount());
+        ASSERT(sharded_server.FindTopDocuments("cat dog"s).empty());
+    }
+}
+
+//Тест проверяет разбор запросов текстового протокола и формат ответов
+void TestRequestHandler() {
+    using namespace std::literals;
+    SearchServer server("and"s);
+    RequestHandler handler(server);
+    std::string response;
+    handler.Handle("ADD 1 0 3 1 2 6 white cat and fluffy tail"sv, response);
+    ASSERT_EQUAL(response, "OK"s);
+    handler.Handle("ADD 2 2 1 -4 black dog\r"sv, response);
+    ASSERT_EQUAL(response, "OK"s);
+    handler.Handle("COUNT"sv, response);
+    ASSERT_EQUAL(response, "OK 2"s);
+    ASSERT(server.MatchDocument("dog"s, 2) == SearchServer::MatchResult({"dog"sv}, DocumentStatus::BANNED));
+
+    handler.Handle("FIND 5 fluffy cat -dog"sv, response);
+    const auto expected = server.FindTopDocuments("fluffy cat -dog"s);
+    ASSERT_EQUAL(expected.size(), 1u);
+    char relevance[32];
+    const auto [relevance_end, error] = std::to_chars(relevance, relevance + sizeof(relevance), expected[0].relevance);
+    ASSERT_EQUAL(response, "OK 1 1 "s + std::string(relevance, relevance_end) + " 3"s);
+    handler.Handle("FIND 0 cat"sv, response);
+    ASSERT_EQUAL(response, "OK 0"s);
+
+    handler.Handle("MATCH 1 tail fluffy -dog"sv, response);
+    ASSERT_EQUAL(response, "OK 0 fluffy tail"s);
+    handler.Handle("MATCH 2 cat"sv, response);
+    ASSERT_EQUAL(response, "OK 2"s);
+
+    handler.Handle("REMOVE 1"sv, response);
+    ASSERT_EQUAL(response, "OK"s);
+    handler.Handle("FIND 5 cat"sv, response);
+    ASSERT_EQUAL(response, "OK 0"s);
+
+    for(const std::string_view request : {"FIND"sv, "FIND x cat"sv, "FIND 5 cat --dog"sv, "MATCH 7 cat"sv, "ADD 2 0 0 dog"sv,
+                                           "ADD 3 9 0 dog"sv, "ADD 3 0 2 1"sv, "ADD 3 0 0 d\x01g"sv, "PING"sv, ""sv}) {
+        handler.Handle(request, response);
+        ASSERT_HINT(response.substr(0, 4) == "ERR "s, "Bad request must produce ERR: "s + std::string(request));
+    }
+    handler.Handle("COUNT"sv, response);
+    ASSERT_EQUAL(response, "OK 1"s);
+}
+
+//Тест проверяет, что кеш выдачи RequestQueue не отдаёт устаревших результатов и ограничен по объёму
+void TestQueryCache() {
+    using namespace std::literals;
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and fluffy tail"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "cat dog"s, DocumentStatus::BANNED, {3});
+    RequestQueue queue(server);
+    std::string normalized_query;
+    const auto check = [&](const std::string& query, DocumentStatus status) {
+        server.NormalizeQuery(query, normalized_query);
+        const auto expected = server.FindTopDocuments(normalized_query, status);
+        const auto result = queue.AddFindRequest(query, status);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for(size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL_HINT(result[i].id, expected[i].id, "Cached result differs for query: "s + query);
+            ASSERT(result[i].relevance == expected[i].relevance);
+        }
+    };
+    check("cat dog"s, DocumentStatus::ACTUAL);
+    check("dog and cat dog"s, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(queue.GetCacheStats().hits, 1u);
+    server.NormalizeQuery("dog -tail and cat -tail dog"s, normalized_query);
+    ASSERT_EQUAL(normalized_query, "cat dog -tail "s);
+    check("cat dog"s, DocumentStatus::BANNED);
+    check("cat -dog"s, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(queue.GetCacheStats().hits, 1u);
+    ASSERT_EQUAL(queue.GetCacheStats().misses, 3u);
+
+    //Изменение набора документов меняет IDF всех слов, поэтому устаревают все записи
+    server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {4});
+    check("cat dog"s, DocumentStatus::ACTUAL);
+    server.RemoveDocument(1);
+    check("cat dog"s, DocumentStatus::ACTUAL);
+    check("cat dog"s, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(queue.GetCacheStats().hits, 2u);
+    ASSERT_EQUAL(queue.GetCacheStats().misses, 5u);
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 0);
+
+    QueryCache cache(16 * 1024);
+    const std::vector<Document> documents(5, Document(1, 0.5, 1));
+    for(int i = 0; i < 10000; ++i) {
+        cache.Insert("query "s + std::to_string(i), 1, documents);
+    }
+    const auto stats = cache.GetStats();
+    ASSERT(stats.bytes <= 16 * 1024);
+    ASSERT(stats.entry_count > 0);
+    ASSERT_EQUAL(stats.evictions + stats.entry_count, 10000u);
+    std::vector<Document> result;
+    ASSERT(cache.Find("query 9999"s, 1, result));
+    ASSERT_EQUAL(result.size(), 5u);
+    ASSERT(!cache.Find("query 9999"s, 2, result));
+    ASSERT(!cache.Find("query 0"s, 1, result));
+}
+
+//Тест проверяет, что пакетное выполнение запросов выдаёт то же, что запросы по одному
+void TestFindTopDocumentsBatch() {
+    using namespace std::literals;
+    std::mt19937 generator(7);
+    std::vector<std::string> dictionary;
+    for(int i = 0; i < 300; ++i) {
+        dictionary.push_back("w"s + std::to_string(i));
+    }
+    std::vector<double> weights;
+    for(size_t i = 0; i < dictionary.size(); ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    std::discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    const auto generate_text = [&](int word_count) {
+        std::string text;
+        for(int i = 0; i < word_count; ++i) {
+            text += dictionary[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+
+    SearchServer server("w2"s);
+    for(int id = 0; id < 12000; ++id) {
+        server.AddDocument(id, generate_text(30), static_cast<DocumentStatus>(id % 3 == 0), {id % 7, id % 5});
+    }
+    for(int id = 0; id < 12000; id += 5) {
+        server.RemoveDocument(id);
+    }
+    //Больше одной группы запросов, повторы слов, минус-слова, совпадающие с плюс-словами других запросов
+    std::vector<std::string> queries;
+    for(int i = 0; i < 150; ++i) {
+        queries.push_back(generate_text(5) + (i % 3 == 0 ? "-"s + dictionary[i % 30] : ""s));
+    }
+    queries.push_back("w2"s);
+    queries.push_back("unknown -w1"s);
+    queries.push_back(""s);
+
+    for(const int top_count : {0, 1, 5, 50}) {
+        const auto par_batch = server.FindTopDocumentsBatch(std::execution::par, queries, DocumentStatus::ACTUAL, top_count);
+        const auto seq_batch = server.FindTopDocumentsBatch(std::execution::seq, queries, DocumentStatus::IRRELEVANT, top_count);
+        ASSERT_EQUAL(par_batch.size(), queries.size());
+        ASSERT_EQUAL(seq_batch.size(), queries.size());
+        ASSERT_EQUAL(par_batch.offsets.back(), par_batch.documents.size());
+        for(size_t i = 0; i < queries.size(); ++i) {
+            for(const auto& [batch, status] : {std::pair{&par_batch, DocumentStatus::ACTUAL}, std::pair{&seq_batch, DocumentStatus::IRRELEVANT}}) {
+                const auto expected = server.FindTopDocuments(queries[i], status, top_count);
+                const auto result = (*batch)[i];
+                ASSERT_EQUAL_HINT(result.size(), expected.size(), "Batch changed the result for query: "s + queries[i]);
+                auto it = result.begin();
+                for(const Document& document : expected) {
+                    ASSERT_EQUAL_HINT(it->id, document.id, "Batch changed the result for query: "s + queries[i]);
+                    ASSERT_HINT(it->relevance == document.relevance, "Batch changed relevance for query: "s + queries[i]);
+                    ++it;
+                }
+            }
+        }
+    }
+    const auto processed = ProcessQueries(server, queries);
+    const auto joined = ProcessQueriesJoined(server, queries);
+    auto joined_it = joined.begin();
+    for(size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(processed[i].size(), expected.size());
+        for(size_t j = 0; j < expected.size(); ++j, ++joined_it) {
+            ASSERT_EQUAL(processed[i][j].id, expected[j].id);
+            ASSERT_EQUAL(joined_it->id, expected[j].id);
+        }
+    }
+    ASSERT(joined_it == joined.end());
+    try {
+        server.FindTopDocumentsBatch(std::execution::seq, {"cat"s, "--dog"s});
+        ASSERT_HINT(false, "Invalid query must throw invalid_argument"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+//Тест проверяет пул потоков: вложенный ParallelFor, исключения и выполнение параллельных перегрузок сервера на пуле
+void TestThreadPool() {
+    using namespace std::literals;
+    for(const int worker_count : {0, 1, 3}) {
+        ThreadPool thread_pool(worker_count, worker_count == 1);
+        ASSERT_EQUAL(thread_pool.GetConcurrency(), worker_count + 1);
+        std::vector<std::atomic<int>> calls(1000);
+        thread_pool.ParallelFor(calls.size(), [&](size_t index) {
+            //Вложенный ParallelFor из задачи пула не должен блокировать поток
+            thread_pool.ParallelFor(3, [&](size_t) {
+                ++calls[index];
+            });
+        });
+        ASSERT(std::all_of(calls.begin(), calls.end(), [](const std::atomic<int>& count) {
+            return count == 3;
+        }));
+        try {
+            thread_pool.ParallelFor(100, [](size_t index) {
+                if (index == 42) {
+                    throw std::out_of_range("index"s);
+                }
+            });
+            ASSERT_HINT(false, "Exception from a task must be rethrown"s);
+        } catch (const std::out_of_range&) {
+        }
+        std::mt19937 generator(worker_count);
+        std::vector<int> values(100000);
+        for(int& value : values) {
+            value = std::uniform_int_distribution(0, 1000)(generator);
+        }
+        std::vector<int> expected = values;
+        std::sort(expected.begin(), expected.end());
+        thread_pool.ParallelSort(values.begin(), values.end(), std::less<int>());
+        ASSERT(values == expected);
+    }
+
+    ThreadPool thread_pool(2);
+    SearchServer server("and"s);
+    SearchServer pooled_server("and"s);
+    pooled_server.SetThreadPool(&thread_pool);
+    std::vector<std::string> texts;
+    std::vector<SearchServer::NewDocument> batch;
+    for(int id = 0; id < 20000; ++id) {
+        texts.push_back("w"s + std::to_string(id % 97) + " w"s + std::to_string(id % 13) + " and w"s + std::to_string(id % 7));
+    }
+    for(int id = 0; id < 20000; ++id) {
+        batch.push_back({id, texts[id], static_cast<DocumentStatus>(id % 11 == 0), {id % 5}});
+    }
+    server.AddDocuments(std::execution::seq, batch);
+    pooled_server.AddDocuments(std::execution::par, batch);
+    for(int id = 0; id < 20000; id += 9) {
+        server.RemoveDocument(std::execution::seq, id);
+        pooled_server.RemoveDocument(std::execution::par, id);
+    }
+    const std::vector<std::string> queries = {"w1 w2 w3"s, "w5 -w6"s, "w96 w12 w0 -w3"s, "w10"s};
+    const auto processed = ProcessQueries(pooled_server, queries);
+    for(size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i], 50);
+        const auto result = pooled_server.FindTopDocuments(std::execution::par, queries[i], 50);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for(size_t j = 0; j < result.size(); ++j) {
+            ASSERT_EQUAL(result[j].id, expected[j].id);
+            ASSERT(result[j].relevance == expected[j].relevance);
+        }
+        ASSERT_EQUAL(processed[i].size(), std::min<size_t>(expected.size(), MAX_RESULT_DOCUMENT_COUNT));
+        for(const int id : {1, 2, 10}) {
+            ASSERT(pooled_server.MatchDocument(std::execution::par, queries[i], id) == server.MatchDocument(queries[i], id));
+        }
+    }
+}
+
+//Тест проверяет, что читатели ConcurrentSearchServer видят только целые версии индекса во время записи
+void TestConcurrentSearchServer() {
+    using namespace std::literals;
+    ConcurrentSearchServer server("and"sv);
+    server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, {1});
+    try {
+        server.AddDocuments({{1, "dog"sv, DocumentStatus::ACTUAL, {1}}, {0, "bird"sv, DocumentStatus::ACTUAL, {1}}});
+        ASSERT_HINT(false, "Duplicate id must throw invalid_argument"s);
+    } catch (const std::invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    ASSERT(server.FindTopDocuments("dog"s).empty());
+
+    //Закреплённая версия не меняется, писатель ждёт её освобождения
+    std::atomic<bool> written = false;
+    std::thread writer;
+    {
+        const auto guard = server.Read();
+        const auto [words, status] = guard->MatchDocument("white cat"s, 0);
+        writer = std::thread([&] {
+            server.RemoveDocument(0);
+            server.AddDocument(1, "black dog"s, DocumentStatus::ACTUAL, {1});
+            written = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_EQUAL(guard->GetDocumentCount(), 1);
+        ASSERT_EQUAL(guard->FindTopDocuments("cat"s).size(), 1u);
+        ASSERT(words == std::vector<std::string_view>({"cat"sv, "white"sv}));
+        ASSERT(!written);
+    }
+    writer.join();
+    ASSERT(server.FindTopDocuments("cat"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 1u);
+
+    //Документы добавляются парами в одной записи, поэтому читатель всегда видит чётное число документов
+    server.AddDocument(2, "fox"s, DocumentStatus::ACTUAL, {1});
+    std::atomic<bool> stop = false;
+    std::atomic<int> reads = 0;
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 3; ++i) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                const auto guard = server.Read();
+                const int document_count = guard->GetDocumentCount();
+                ASSERT_EQUAL(document_count % 2, 0);
+                ASSERT_EQUAL(static_cast<int>(guard->FindTopDocuments("pair"s, 1000).size()), document_count - 2);
+                ++reads;
+            }
+        });
+    }
+    for(int id = 100; id < 300; id += 2) {
+        const std::string text = "pair "s + std::to_string(id);
+        server.AddDocuments({{id, text, DocumentStatus::ACTUAL, {1}}, {id + 1, text, DocumentStatus::ACTUAL, {2}}});
+        if (id % 20 == 0) {
+            server.RemoveDocuments({id, id + 1});
+        }
+        std::this_thread::yield();
+    }
+    while (reads < 100) {
+        std::this_thread::yield();
+    }
+    stop = true;
+    for(std::thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 2 + 200 - 20);
+}
+
+//Тест проверяет поиск точных дубликатов по отпечаткам и почти-дубликатов по MinHash
+void TestRemoveDuplicates() {
+    using namespace std::literals;
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(10, "and with"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(11, "with"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(FindDuplicates(server) == std::vector<int>({3, 4, 5, 7, 11}));
+
+    std::ostringstream output;
+    std::streambuf* cout_buffer = std::cout.rdbuf(output.rdbuf());
+    RemoveDuplicates(server);
+    std::cout.rdbuf(cout_buffer);
+    ASSERT_EQUAL(output.str(), "Found duplicate document id 3\nFound duplicate document id 4\nFound duplicate document id 5\n"
+                               "Found duplicate document id 7\nFound duplicate document id 11\n"s);
+    ASSERT_EQUAL(server.GetDocumentCount(), 6);
+    ASSERT(FindDuplicates(server).empty());
+
+    //Отпечатки дают тот же результат, что сравнение множеств слов
+    std::mt19937 generator(5);
+    SearchServer random_server(""s);
+    std::set<std::set<std::string>> seen;
+    std::vector<int> expected;
+    for(int id = 0; id < 3000; ++id) {
+        std::string text;
+        std::set<std::string> words;
+        for(int i = 0; i < 3; ++i) {
+            const std::string word = "w"s + std::to_string(std::uniform_int_distribution(0, 12)(generator));
+            text += word + " "s;
+            words.insert(word);
+        }
+        random_server.AddDocument(id, text, DocumentStatus::ACTUAL, {1});
+        if (!seen.insert(words).second) {
+            expected.push_back(id);
+        }
+    }
+    ASSERT(FindDuplicates(random_server) == expected);
+
+    //Почти-дубликаты: 20 общих слов из 21 (Жаккар ~0.952) и 20 из 22 (~0.909) - дубликаты, 10 из 30 - нет
+    SearchServer near_server(""s);
+    std::string base;
+    for(int i = 0; i < 20; ++i) {
+        base += "w"s + std::to_string(i) + " "s;
+    }
+    near_server.AddDocument(1, base, DocumentStatus::ACTUAL, {1});
+    near_server.AddDocument(2, base + "x1"s, DocumentStatus::ACTUAL, {1});
+    near_server.AddDocument(3, base + "x2 x3"s, DocumentStatus::ACTUAL, {1});
+    std::string distant;
+    for(int i = 10; i < 30; ++i) {
+        distant += "w"s + std::to_string(i) + " "s;
+    }
+    near_server.AddDocument(4, distant, DocumentStatus::ACTUAL, {1});
+    near_server.AddDocument(5, base, DocumentStatus::ACTUAL, {1});
+    ASSERT(FindNearDuplicates(near_server) == std::vector<int>({2, 3, 5}));
+    ASSERT(FindNearDuplicates(near_server, {0.95, 16, 4}) == std::vector<int>({2, 5}));
+    ASSERT(FindNearDuplicates(near_server, {0.96, 16, 4}) == std::vector<int>({5}));
+    //Одна строка в полосе: пара с Жаккаром 1/3 становится кандидатом почти наверняка
+    ASSERT(FindNearDuplicates(near_server, {0.3, 64, 1}) == std::vector<int>({2, 3, 4, 5}));
+    try {
+        FindNearDuplicates(near_server, {1.5, 16, 4});
+        ASSERT_HINT(false, "Invalid threshold must throw invalid_argument"s);
+    } catch (const std::invalid_argument&) {
+    }
+    output.str(""s);
+    cout_buffer = std::cout.rdbuf(output.rdbuf());
+    RemoveNearDuplicates(near_server);
+    std::cout.rdbuf(cout_buffer);
+    ASSERT_EQUAL(near_server.GetDocumentCount(), 2);
+}
+
+//Тест проверяет, что в режиме дедупликации дубликаты не попадают в индекс и передаются в обработчик
+void TestIngestDeduplication() {
+    using namespace std::literals;
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "nasty rat"s, DocumentStatus::ACTUAL, {1});
+    //Уже имеющиеся дубликаты не мешают включению режима
+    server.AddDocument(3, "nasty nasty rat"s, DocumentStatus::ACTUAL, {1});
+    using Duplicates = std::vector<std::pair<int, int>>;
+    Duplicates duplicates;
+    server.EnableIngestDeduplication([&duplicates](int duplicate_id, int original_id) {
+        duplicates.emplace_back(duplicate_id, original_id);
+    });
+    ASSERT(server.IsIngestDeduplicationEnabled());
+    const uint64_t generation = server.GetGeneration();
+    server.AddDocument(4, "rat with funny nasty pet"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    ASSERT_EQUAL(server.GetGeneration(), generation);
+    ASSERT(duplicates == Duplicates({{4, 1}}));
+
+    //Дубликаты внутри пакета, в том числе из новых слов, и дубликаты уже добавленных документов
+    duplicates.clear();
+    server.AddDocuments({{5, "curly hair"sv, DocumentStatus::ACTUAL, {1}},
+                         {6, "funny pet nasty rat"sv, DocumentStatus::ACTUAL, {1}},
+                         {7, "hair and curly"sv, DocumentStatus::ACTUAL, {1}},
+                         {8, "funny pet"sv, DocumentStatus::ACTUAL, {1}},
+                         {9, "funny rat"sv, DocumentStatus::BANNED, {1}}});
+    ASSERT(duplicates == Duplicates({{6, 1}, {7, 5}}));
+    ASSERT_EQUAL(server.GetDocumentCount(), 6);
+    ASSERT(server.FindTopDocuments("curly"s).size() == 1);
+    ASSERT(server.GetWordFrequencies(6).empty());
+
+    //Некорректный документ отменяет пакет целиком, обработчик не вызывается
+    duplicates.clear();
+    try {
+        server.AddDocuments({{10, "curly hair"sv, DocumentStatus::ACTUAL, {1}}, {11, "bad\x01word"sv, DocumentStatus::ACTUAL, {1}}});
+        ASSERT_HINT(false, "Invalid batch must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+    ASSERT(duplicates.empty());
+
+    //После удаления оригинала такой же документ снова добавляется
+    server.RemoveDocument(5);
+    server.AddDocument(10, "curly hair"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(11, "nasty rat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(duplicates == Duplicates({{11, 2}}));
+    ASSERT_EQUAL(server.GetDocumentCount(), 6);
+
+    //Без режима дубликаты добавляются как раньше, и FindDuplicates их находит
+    server.DisableIngestDeduplication();
+    server.AddDocument(12, "hair curly"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(FindDuplicates(server) == std::vector<int>({3, 12}));
+}
+
+//Тест проверяет, что пакетный MatchDocuments совпадает с MatchDocument для каждого документа
+void TestMatchDocuments() {
+    using namespace std::literals;
+    std::mt19937 generator(20);
+    std::uniform_int_distribution<int> word_distribution(0, 40);
+    const auto generate_text = [&](int word_count) {
+        std::string text;
+        for(int i = 0; i < word_count; ++i) {
+            text += "w"s + std::to_string(word_distribution(generator)) + " "s;
+        }
+        return text;
+    };
+    SearchServer server("w3"s);
+    ThreadPool thread_pool(2);
+    server.SetThreadPool(&thread_pool);
+    //Документов больше MIN_DOCUMENTS_PER_CHUNK, чтобы параллельная версия делила пакет на части
+    for(int id = 0; id < 9000; ++id) {
+        server.AddDocument(id * 2, generate_text(8), static_cast<DocumentStatus>(id % 4), {1});
+    }
+    for(int id = 0; id < 18000; id += 14) {
+        server.RemoveDocument(id);
+    }
+    const std::vector<std::string> queries = {"w1 w2 w3 w40"s, "w5 w6 -w7"s, "w10 w10 -w11 -w12 unknown"s, "-unknown w9"s, ""s};
+    std::vector<int> some_ids = {6, 2, 17998, 6};
+    for(const std::string& query : queries) {
+        for(const auto& result : {server.MatchDocuments(std::execution::par, query), server.MatchDocuments(query),
+                                  server.MatchDocuments(std::execution::par, query, some_ids)}) {
+            ASSERT_EQUAL(result.offsets.size(), result.size() + 1);
+            for(size_t i = 0; i < result.size(); ++i) {
+                const auto [words, status] = server.MatchDocument(query, result.document_ids[i]);
+                const auto batch_words = result[i];
+                ASSERT_HINT(std::vector<std::string_view>(batch_words.begin(), batch_words.end()) == words,
+                            "Batch changed matched words for query: "s + query);
+                ASSERT(result.statuses[i] == status);
+            }
+        }
+        const auto all = server.MatchDocuments(std::execution::seq, query);
+        ASSERT(all.document_ids == std::vector<int>(server.begin(), server.end()));
+        ASSERT(server.MatchDocuments(query, some_ids).document_ids == some_ids);
+    }
+    ASSERT(server.MatchDocuments("w1"s, {}).size() == 0);
+    try {
+        server.MatchDocuments("w1"s, {2, 0});
+        ASSERT_HINT(false, "Removed document must throw out_of_range"s);
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        server.MatchDocuments(std::execution::par, "--w1"s);
+        ASSERT_HINT(false, "Invalid query must throw invalid_argument"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+//Тест проверяет гистограммы и счётчики реестра метрик и их заполнение сервером и очередью запросов
+void TestMetrics() {
+    using namespace std::literals;
+    //Верхняя граница корзины не меньше значения и завышает его не больше чем на 1 / SUB_BUCKET_COUNT
+    for(uint64_t value : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull, ~0ull}) {
+        const int bucket = LatencyHistogram::GetBucket(value);
+        ASSERT(bucket < LatencyHistogram::BUCKET_COUNT);
+        const uint64_t upper_bound = LatencyHistogram::GetBucketUpperBound(bucket);
+        ASSERT(upper_bound >= value);
+        ASSERT(upper_bound - value <= value / LatencyHistogram::SUB_BUCKET_COUNT);
+        ASSERT(bucket == 0 || LatencyHistogram::GetBucketUpperBound(bucket - 1) < value);
+    }
+
+    MetricsRegistry metrics;
+    LatencyHistogram& histogram = metrics.GetHistogram("test.latency_ns"sv);
+    ASSERT(&histogram == &metrics.GetHistogram("test.latency_ns"sv));
+    Counter& counter = metrics.GetCounter("test.events"sv);
+    std::vector<std::thread> threads;
+    for(int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&histogram, &counter] {
+            for(int value = 1; value <= 1000; ++value) {
+                histogram.Record(value);
+                counter.Add();
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    const auto snapshot = histogram.GetSnapshot();
+    ASSERT_EQUAL(snapshot.count, 4000u);
+    ASSERT_EQUAL(snapshot.sum_ns, 4u * 500500u);
+    ASSERT_EQUAL(counter.Get(), 4000u);
+    ASSERT(snapshot.GetPercentile(0.5) >= 500 && snapshot.GetPercentile(0.5) <= 500 + 500 / 8);
+    ASSERT(snapshot.GetPercentile(1.0) >= 1000 && snapshot.GetPercentile(1.0) <= 1000 + 1000 / 8);
+
+    SearchServer server("and"s);
+    server.SetMetrics(&metrics);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    ASSERT_EQUAL(metrics.GetGauge("search_server.documents"sv).Get(), 3);
+    ASSERT_EQUAL(metrics.GetHistogram("search_server.add_documents_ns"sv).GetSnapshot().count, 3u);
+    server.FindTopDocuments("fluffy cat -collar"s);
+    server.FindTopDocuments(std::execution::par, "dog"s);
+    ASSERT_EQUAL(metrics.GetHistogram("search_server.find_top_documents_ns"sv).GetSnapshot().count, 2u);
+    ASSERT_EQUAL(metrics.GetCounter("search_server.minus_word_exclusions"sv).Get(), 1u);
+    ASSERT_EQUAL(metrics.GetCounter("search_server.documents_matched"sv).Get(), 2u);
+    ASSERT(metrics.GetCounter("search_server.postings_scanned"sv).Get() >= 2u);
+    //Считаются кандидаты плюс-слов, а не постинги минус-слов: документ 1 с двумя минус-словами - один раз,
+    //документ 3 без плюс-слов не считается
+    server.FindTopDocuments("cat -white -collar -dog"s);
+    ASSERT_EQUAL(metrics.GetCounter("search_server.minus_word_exclusions"sv).Get(), 2u);
+    server.MatchDocument("cat"s, 1);
+    server.RemoveDocument(3);
+    ASSERT_EQUAL(metrics.GetHistogram("search_server.match_document_ns"sv).GetSnapshot().count, 1u);
+    ASSERT_EQUAL(metrics.GetGauge("search_server.documents"sv).Get(), 2);
+
+    RequestQueue request_queue(server);
+    request_queue.SetMetrics(&metrics);
+    request_queue.AddFindRequest("cat"s);
+    request_queue.AddFindRequest("cat cat"s);
+    request_queue.AddFindRequest("parrot"s);
+    ASSERT_EQUAL(metrics.GetCounter("request_queue.cache_hits"sv).Get(), 1u);
+    ASSERT_EQUAL(metrics.GetCounter("request_queue.cache_misses"sv).Get(), 2u);
+    ASSERT_EQUAL(metrics.GetCounter("request_queue.empty_results"sv).Get(), 1u);
+
+    //Промахи очереди выполнили ещё два поиска, без реестра сервер ничего не пишет
+    ASSERT_EQUAL(metrics.GetHistogram("search_server.find_top_documents_ns"sv).GetSnapshot().count, 5u);
+    server.SetMetrics(nullptr);
+    server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(metrics.GetHistogram("search_server.find_top_documents_ns"sv).GetSnapshot().count, 5u);
+
+    std::ostringstream text;
+    metrics.DumpText(text);
+    ASSERT(text.str().find("test.events 4000\n"s) != std::string::npos);
+    ASSERT(text.str().find("search_server.documents 2\n"s) != std::string::npos);
+    RequestHandler handler(server, &metrics);
+    std::string response;
+    handler.Handle("METRICS"sv, response);
+    ASSERT(response.rfind("OK {\"counters\": {"s, 0) == 0);
+    ASSERT(response.find("\"request_queue.cache_hits\": 1"s) != std::string::npos);
+    ASSERT(response.find("\"test.latency_ns\": {\"count\": 4000, \"mean_ns\": 500"s) != std::string::npos);
+    ASSERT(response.find('\n') == std::string::npos);
+}
+
+//Тест проверяет, что FindTopDocumentsExplained не меняет выдачу и правильно раскладывает её по словам и этапам
+void TestFindTopDocumentsExplained() {
+    using namespace std::literals;
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(4, "fluffy dog in collar"s, DocumentStatus::BANNED, {9});
+    SearchServer::QueryTrace trace;
+    const auto result = server.FindTopDocumentsExplained("fluffy cat dog -collar parrot"s, trace);
+    const auto expected = server.FindTopDocuments("fluffy cat dog -collar parrot"s);
+    ASSERT_EQUAL(result.size(), expected.size());
+    for(size_t i = 0; i < result.size(); ++i) {
+        ASSERT_EQUAL(result[i].id, expected[i].id);
+        ASSERT(result[i].relevance == expected[i].relevance);
+    }
+    std::vector<std::string_view> stage_names;
+    for(const auto& stage : trace.stages) {
+        stage_names.push_back(stage.name);
+        ASSERT(stage.duration_ns >= 0);
+    }
+    ASSERT(stage_names == std::vector<std::string_view>({"parse"sv, "resolve_terms"sv, "traverse"sv, "merge"sv, "sort"sv}));
+    //parrot нет в словаре
+    ASSERT_EQUAL(trace.terms.size(), 4u);
+    ASSERT_EQUAL(trace.terms[0].word, "fluffy"sv);
+    ASSERT_EQUAL(trace.terms[0].document_freq, 2);
+    ASSERT(std::abs(trace.terms[0].inverse_document_freq - std::log(4.0 / 2)) < 1e-12);
+    ASSERT(trace.terms[3].is_minus && trace.terms[3].word == "collar"sv && trace.terms[3].posting_count == 2u);
+    //Все четыре документа - кандидаты, 1 и 4 исключены минус-словом до проверки предиката
+    ASSERT_EQUAL(trace.counters.candidates, 4u);
+    ASSERT_EQUAL(trace.counters.minus_excluded, 2u);
+    ASSERT_EQUAL(trace.counters.predicate_rejected, 0u);
+    ASSERT_EQUAL(trace.counters.rescored + trace.counters.pruned, 2u);
+    ASSERT_EQUAL(trace.documents.size(), result.size());
+    ASSERT_EQUAL(trace.documents[0].document_id, 2);
+    ASSERT_EQUAL(trace.documents[0].contributions.size(), 2u);
+    ASSERT_EQUAL(trace.documents[0].contributions[0].first, "fluffy"sv);
+    ASSERT(std::abs(trace.documents[0].contributions[0].second - 0.5 * std::log(2.0)) < 1e-12);
+    std::ostringstream output;
+    trace.Print(output);
+    ASSERT(output.str().find("  -collar df=2"s) != std::string::npos);
+
+    //На большом индексе с отсечением и предикатом: выдача та же, вклады слов складываются в релевантность
+    std::mt19937 generator(23);
+    std::uniform_int_distribution<int> word_distribution(0, 200);
+    SearchServer random_server(""s);
+    for(int id = 0; id < 10000; ++id) {
+        std::string text;
+        for(int i = 0; i < 10; ++i) {
+            text += "w"s + std::to_string(word_distribution(generator) * word_distribution(generator) / 200) + " "s;
+        }
+        random_server.AddDocument(id, text, static_cast<DocumentStatus>(id % 4), {id % 11});
+    }
+    const auto predicate = [](int document_id, DocumentStatus, int rating) {
+        return document_id % 3 != 0 && rating > 2;
+    };
+    for(const std::string& query : {"w0 w1 w50 w150"s, "w3 w7 -w0"s, "w180 w199 w2 w1 w0"s}) {
+        const auto explained = random_server.FindTopDocumentsExplained(std::execution::par, query, predicate, trace, 20);
+        const auto plain = random_server.FindTopDocuments(std::execution::seq, query, predicate, 20);
+        ASSERT_EQUAL(explained.size(), plain.size());
+        for(size_t i = 0; i < plain.size(); ++i) {
+            ASSERT_EQUAL(explained[i].id, plain[i].id);
+            double relevance = 0;
+            for(const auto& [word, contribution] : trace.documents[i].contributions) {
+                relevance += contribution;
+            }
+            ASSERT(std::abs(relevance - plain[i].relevance) < 1e-12);
+        }
+        ASSERT(trace.counters.predicate_rejected > 0);
+        ASSERT_EQUAL(trace.counters.rescored + trace.counters.pruned,
+                     trace.counters.candidates - trace.counters.minus_excluded - trace.counters.predicate_rejected);
+        ASSERT(trace.counters.postings_traversed + trace.counters.postings_probed <= trace.counters.postings_total);
+    }
+}
+
+//Тест проверяет, что арена возвращает память при уничтожении, вложенные арены не пересекаются, а буфер растёт после переполнения
+void TestScratchArena() {
+    using namespace std::literals;
+    void* outer_memory;
+    void* inner_memory;
+    {
+        const ScratchArena outer;
+        outer_memory = outer.GetResource()->allocate(64);
+        {
+            const ScratchArena inner;
+            ASSERT(inner.GetResource() != outer.GetResource());
+            inner_memory = inner.GetResource()->allocate(64);
+        }
+        //Повторная вложенная арена получает тот же сброшенный буфер
+        const ScratchArena inner;
+        ASSERT_EQUAL(inner.GetResource()->allocate(64), inner_memory);
+        ASSERT(outer.GetResource()->allocate(64) != outer_memory);
+    }
+    size_t overflow_size;
+    {
+        const ScratchArena arena;
+        ASSERT_EQUAL(arena.GetResource()->allocate(64), outer_memory);
+        overflow_size = arena.GetCapacity() * 3;
+        std::pmr::vector<char> data(overflow_size, 'x', arena.GetResource());
+        ASSERT_EQUAL(data.back(), 'x');
+    }
+    {
+        const ScratchArena arena;
+        ASSERT(arena.GetCapacity() >= overflow_size);
+    }
+}
+
+//Тест проверяет словарь слов и раскрытие шаблонов запроса с ограничением числа раскрытий
+void TestWordPatterns() {
+    using namespace std::literals;
+    ASSERT(MatchesPattern("ca*"sv, "cat"sv) && MatchesPattern("ca*"sv, "ca"sv) && !MatchesPattern("ca*"sv, "dog"sv));
+    ASSERT(MatchesPattern("c?t"sv, "cut"sv) && !MatchesPattern("c?t"sv, "ct"sv) && !MatchesPattern("c?t"sv, "cart"sv));
+    ASSERT(MatchesPattern("*a*b"sv, "xaxab"sv) && !MatchesPattern("*a*b"sv, "xaxa"sv) && MatchesPattern("a*"sv, "a*b"sv));
+    ASSERT_EQUAL(GetPatternPrefix("cat?s*"sv), "cat"sv);
+    //'?' и '*' отсчитывают кодовые точки UTF-8: кириллическая буква занимает два байта
+    ASSERT(MatchesPattern("к?т"sv, "кот"sv) && !MatchesPattern("к??т"sv, "кот"sv) && MatchesPattern("к?t"sv, "кit"sv));
+    ASSERT(MatchesPattern("к*т?"sv, "кошты"sv) && !MatchesPattern("к*т?"sv, "кошт"sv) && MatchesPattern("??"sv, "ёж"sv));
+
+    //Пустое слово в пустом словаре не требует блока
+    TermDictionary empty_word_dictionary;
+    ASSERT_EQUAL(empty_word_dictionary.Intern(""sv), 0);
+    ASSERT(empty_word_dictionary.GetTerm(0).empty());
+    ASSERT_EQUAL(empty_word_dictionary.Intern("cat"sv), 1);
+    ASSERT_EQUAL(empty_word_dictionary.Find(""sv), 0);
+
+    TermDictionary dictionary;
+    ASSERT_EQUAL(dictionary.Find("cat"sv), TermDictionary::NO_TERM);
+    ASSERT_EQUAL(dictionary.Intern("cat"sv), 0);
+    const std::string_view cat = dictionary.GetTerm(0);
+    std::vector<std::string> words;
+    for(int i = 0; i < 5000; ++i) {
+        words.push_back("w"s + std::to_string(i * 7919 % 5000));
+        ASSERT_EQUAL(dictionary.Intern(words.back()), i + 1);
+    }
+    words.push_back(std::string(100000, 'z'));
+    ASSERT_EQUAL(dictionary.Intern(words.back()), 5001);
+    ASSERT_EQUAL(dictionary.Intern("cat"sv), 0);
+    //Слова не перемещаются при росте словаря
+    ASSERT_EQUAL(dictionary.GetTerm(0).data(), cat.data());
+    ASSERT_EQUAL(dictionary.Find(words[1234]), 1235);
+    ASSERT_EQUAL(dictionary.GetTerm(5001), words.back());
+    const std::vector<int> sorted_ids = dictionary.GetSortedIds();
+    ASSERT_EQUAL(sorted_ids.size(), dictionary.size());
+    ASSERT(std::is_sorted(sorted_ids.begin(), sorted_ids.end(), [&dictionary](int lhs, int rhs) {
+        return dictionary.GetTerm(lhs) < dictionary.GetTerm(rhs);
+    }));
+    std::set<std::string_view> with_prefix;
+    dictionary.ForEachWithPrefix("w49"sv, [&](int term_id) {
+        with_prefix.insert(dictionary.GetTerm(term_id));
+    });
+    ASSERT_EQUAL(with_prefix.size(), 111u); //w49, w490-w499, w4900-w4999
+    ASSERT(with_prefix.count("w49"sv) && with_prefix.count("w4999"sv) && !with_prefix.count("w5"sv));
+
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "catalog of cards"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "cart with cut"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "parrot"s, DocumentStatus::ACTUAL, {4});
+    const auto get_ids = [&server](std::string_view query) {
+        std::set<int> ids;
+        for(const Document& document : server.FindTopDocuments(query, 100)) {
+            ids.insert(document.id);
+        }
+        return ids;
+    };
+    ASSERT(get_ids("ca*"sv) == std::set<int>({1, 2, 3}));
+    ASSERT(get_ids("c?t"sv) == std::set<int>({1, 3}));
+    ASSERT(get_ids("ca* -cat*"sv) == std::set<int>({3}));
+    ASSERT(get_ids("parr?t an*"sv) == std::set<int>({4}));
+    //Шаблон без литерального начала обходил бы весь словарь и отклоняется
+    for(const std::string_view query : {"*"sv, "cat ?at"sv, "cat -*"sv, "cat -?og"sv}) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "Pattern without a literal prefix must throw invalid_argument"s);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    ASSERT(get_ids("x*"sv).empty());
+    const auto [matched_words, status] = server.MatchDocument("car* -dog"sv, 2);
+    ASSERT(matched_words == std::vector<std::string_view>({"cards"sv}));
+    ASSERT(std::get<0>(server.MatchDocument("ca* -d*"sv, 1)).empty());
+    //Слово из раскрытия оценивается как обычное плюс-слово
+    const auto pattern_result = server.FindTopDocuments("cat?log"sv);
+    const auto word_result = server.FindTopDocuments("catalog"sv);
+    ASSERT_EQUAL(pattern_result.size(), 1u);
+    ASSERT_EQUAL(pattern_result[0].relevance, word_result[0].relevance);
+    //Слово запроса, повторённое раскрытием не рядом с ним, не удваивает вклад
+    const auto repeated_result = server.FindTopDocuments("cat dog cat*"sv);
+    const auto unique_result = server.FindTopDocuments("cat dog catalog"sv);
+    ASSERT_EQUAL(repeated_result.size(), unique_result.size());
+    for(size_t i = 0; i < repeated_result.size(); ++i) {
+        ASSERT_EQUAL(repeated_result[i].id, unique_result[i].id);
+        ASSERT_EQUAL(repeated_result[i].relevance, unique_result[i].relevance);
+    }
+
+    //Из раскрытия w* в запрос попадают MAX_PATTERN_EXPANSIONS самых частых слов
+    SearchServer wide_server(""s);
+    const int word_count = static_cast<int>(MAX_PATTERN_EXPANSIONS) + 4;
+    int id = 0;
+    for(int word = 0; word < word_count; ++word) {
+        //Слово w<word> встречается в word + 1 документах
+        for(int copy = 0; copy <= word; ++copy) {
+            wide_server.AddDocument(id++, "w"s + std::to_string(word), DocumentStatus::ACTUAL, {1});
+        }
+    }
+    std::set<std::string_view> expanded;
+    for(int document_id = 0; document_id < id; ++document_id) {
+        const auto [document_words, document_status] = wide_server.MatchDocument("w*"sv, document_id);
+        expanded.insert(document_words.begin(), document_words.end());
+    }
+    ASSERT_EQUAL(expanded.size(), MAX_PATTERN_EXPANSIONS);
+    ASSERT(!expanded.count("w3"sv) && expanded.count("w4"sv));
+    ASSERT(wide_server.FindTopDocuments("w* -w*"sv).empty());
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() {
     RUN_TEST(TestAddDocument);
@@ -365,4 +1731,27 @@ void TestSearchServer() {
     RUN_TEST(TestSorting);
     RUN_TEST(TestPredicate);
     RUN_TEST(TestFindByStatus);
+    RUN_TEST(TestRemoveDocument);
+    RUN_TEST(TestTopCount);
+    RUN_TEST(TestPruning);
+    RUN_TEST(TestInverseDocumentFreqUpdates);
+    RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestRemoveDocuments);
+    RUN_TEST(TestSnapshot);
+    RUN_TEST(TestCorruptedSnapshot);
+    RUN_TEST(TestPostingList);
+    RUN_TEST(TestTokenizer);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestRequestHandler);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestFindTopDocumentsBatch);
+    RUN_TEST(TestThreadPool);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestRemoveDuplicates);
+    RUN_TEST(TestIngestDeduplication);
+    RUN_TEST(TestMatchDocuments);
+    RUN_TEST(TestMetrics);
+    RUN_TEST(TestFindTopDocumentsExplained);
+    RUN_TEST(TestScratchArena);
+    RUN_TEST(TestWordPatterns);
 }
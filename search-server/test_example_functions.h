@@ -8,10 +8,28 @@
 #include <cassert>
 #include <algorithm>
 #include <numeric>
-
+#include <random>
+#include <limits>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <charconv>
+
+#include "concurrent_search_server.h"
 #include "document.h"
+#include "metrics.h"
 #include "process_queries.h"
+#include "query_cache.h"
+#include "request_handler.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "scratch_arena.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "snapshot.h"
+#include "term_dictionary.h"
+#include "thread_pool.h"
 
 const double COMPARISON_PRECISION = 1e-6;
 //Переопределяем стандартный вывод для массивов
@@ -128,6 +146,53 @@ void TestSorting();
 void TestPredicate();
 //Тест проверяет поведение перегруженных функций FindTopDocuments
 void TestFindByStatus();
+//Тест проверяет удаление документов из индекса
+void TestRemoveDocument();
+//Тест проверяет ограничение размера выдачи
+void TestTopCount();
+//Тест проверяет, что отсечение MaxScore не меняет выдачу по сравнению с полным перебором
+void TestPruning();
+//Тест проверяет, что закешированный IDF пересчитывается после изменения набора документов
+void TestInverseDocumentFreqUpdates();
+//Тест проверяет пакетное добавление документов
+void TestAddDocuments();
+//Тест проверяет пакетное удаление и уплотнение индекса
+void TestRemoveDocuments();
+//Тест проверяет сохранение и загрузку снимка индекса
+void TestSnapshot();
+
+//Тест проверяет, что снимок с номерами документов, словами или статусами вне допустимых значений не загружается
+void TestCorruptedSnapshot();
+//Тест проверяет сжатый постинг-лист на разных ширинах разностей номеров
+void TestPostingList();
+//Тест проверяет блочный токенизатор: границы слов на стыках блоков и поиск управляющих символов
+void TestTokenizer();
+//Тест проверяет, что шардированный сервер выдаёт то же, что один сервер с теми же документами
+void TestShardedSearchServer();
+//Тест проверяет разбор запросов текстового протокола и формат ответов
+void TestRequestHandler();
+//Тест проверяет, что кеш выдачи RequestQueue не отдаёт устаревших результатов и ограничен по объёму
+void TestQueryCache();
+//Тест проверяет, что пакетное выполнение запросов выдаёт то же, что запросы по одному
+void TestFindTopDocumentsBatch();
+//Тест проверяет пул потоков: вложенный ParallelFor, исключения и выполнение параллельных перегрузок сервера на пуле
+void TestThreadPool();
+//Тест проверяет, что читатели ConcurrentSearchServer видят только целые версии индекса во время записи
+void TestConcurrentSearchServer();
+//Тест проверяет поиск точных дубликатов по отпечаткам и почти-дубликатов по MinHash
+void TestRemoveDuplicates();
+//Тест проверяет, что в режиме дедупликации дубликаты не попадают в индекс и передаются в обработчик
+void TestIngestDeduplication();
+//Тест проверяет, что пакетный MatchDocuments совпадает с MatchDocument для каждого документа
+void TestMatchDocuments();
+//Тест проверяет гистограммы и счётчики реестра метрик и их заполнение сервером и очередью запросов
+void TestMetrics();
+//Тест проверяет, что FindTopDocumentsExplained не меняет выдачу и правильно раскладывает её по словам и этапам
+void TestFindTopDocumentsExplained();
+//Тест проверяет, что арена возвращает память при уничтожении, вложенные арены не пересекаются, а буфер растёт после переполнения
+void TestScratchArena();
+//Тест проверяет словарь слов и раскрытие шаблонов запроса с ограничением числа раскрытий
+void TestWordPatterns();
 
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer();
\ No newline at end of file
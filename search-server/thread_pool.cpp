@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+//Пул и номер очереди текущего потока, если он фоновый поток пула
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+//Задач на поток: запас для выравнивания нагрузки при неравных по стоимости индексах
+const size_t TASKS_PER_THREAD = 4;
+//Сколько раз ожидающий поток уступает процессор, прежде чем заснуть до завершения группы
+const int MAX_IDLE_SPINS = 64;
+
+}
+
+ThreadPool::ThreadPool(int worker_count, bool pin_threads) {
+    using std::literals::string_literals::operator""s;
+    if (worker_count < 0) {
+        throw std::invalid_argument("Worker count must not be negative"s);
+    }
+    for (int i = 0; i <= worker_count; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    const unsigned cpu_count = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this, i] {
+            WorkerLoop(i);
+        });
+#ifdef __linux__
+        if (pin_threads) {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET((i + 1) % cpu_count, &cpu_set);
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpu_set), &cpu_set);
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+int ThreadPool::GetDefaultWorkerCount() {
+    return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+int ThreadPool::GetConcurrency() const {
+    return static_cast<int>(workers_.size()) + 1;
+}
+
+void ThreadPool::Run(TaskGroup& group, size_t count) {
+    const size_t task_count = std::min(count, TASKS_PER_THREAD * GetConcurrency());
+    group.pending = task_count;
+    const size_t home_queue = GetHomeQueue();
+    {
+        Queue& queue = *queues_[home_queue];
+        std::lock_guard lock(queue.mutex);
+        for (size_t task = 0; task < task_count; ++task) {
+            queue.tasks.push_back({&group, count * task / task_count, count * (task + 1) / task_count});
+        }
+    }
+    {
+        std::lock_guard lock(sleep_mutex_);
+        queued_ += task_count;
+    }
+    wake_.notify_all();
+    //Пока группа не завершена, поток выполняет любые задачи, в том числе чужих групп. Если очереди пусты,
+    //остаток группы выполняют другие потоки: после короткого ожидания поток засыпает, не занимая ядро
+    int idle_spins = 0;
+    while (group.pending.load(std::memory_order_acquire) > 0) {
+        if (TryRunTask(home_queue)) {
+            idle_spins = 0;
+        } else if (++idle_spins < MAX_IDLE_SPINS) {
+            std::this_thread::yield();
+        } else {
+            std::unique_lock lock(group.mutex);
+            group.done.wait(lock, [&group] {
+                return group.pending.load(std::memory_order_acquire) == 0;
+            });
+        }
+    }
+    //Последняя задача уменьшает счётчик под мьютексом группы: группу можно уничтожать, только когда он отпущен
+    std::lock_guard lock(group.mutex);
+}
+
+bool ThreadPool::TryRunTask(size_t home_queue) {
+    Task task;
+    bool found = false;
+    {
+        Queue& queue = *queues_[home_queue];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (size_t i = 1; !found && i < queues_.size(); ++i) {
+        Queue& queue = *queues_[(home_queue + i) % queues_.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    --queued_;
+    RunTask(task);
+    return true;
+}
+
+void ThreadPool::RunTask(const Task& task) {
+    TaskGroup& group = *task.group;
+    try {
+        for (size_t index = task.first; index < task.last; ++index) {
+            group.invoke(group.func, index);
+        }
+    } catch (...) {
+        std::lock_guard lock(group.mutex);
+        if (!group.error) {
+            group.error = std::current_exception();
+        }
+    }
+    //После того как мьютекс отпущен, группа может быть уничтожена ожидающим потоком
+    std::lock_guard lock(group.mutex);
+    if (group.pending.fetch_sub(1, std::memory_order_release) == 1) {
+        group.done.notify_all();
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t worker_index) {
+    current_pool = this;
+    current_queue = worker_index;
+    while (true) {
+        if (TryRunTask(worker_index)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] {
+            return stopping_ || queued_ > 0;
+        });
+        if (stopping_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+size_t ThreadPool::GetHomeQueue() const {
+    return current_pool == this ? current_queue : queues_.size() - 1;
+}
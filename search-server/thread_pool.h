@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Пул потоков с перехватом задач. У каждого потока пула своя очередь: владелец берёт задачи с конца,
+//свободные потоки забирают их с начала чужих очередей. Поток, ожидающий завершения ParallelFor, сам
+//выполняет задачи, поэтому вложенный параллелизм не создаёт лишних потоков и не приводит к взаимоблокировке
+class ThreadPool {
+public:
+    //worker_count - число фоновых потоков, вызывающий ParallelFor поток работает вместе с ними.
+    //pin_threads закрепляет фоновые потоки за ядрами (только Linux)
+    explicit ThreadPool(int worker_count = GetDefaultWorkerCount(), bool pin_threads = false);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //По фоновому потоку на ядро, кроме ядра вызывающего потока
+    static int GetDefaultWorkerCount();
+    //Сколько потоков одновременно выполняют ParallelFor: фоновые и вызывающий
+    int GetConcurrency() const;
+
+    //Вызывает func(index) для каждого index из [0, count) и возвращается, когда все вызовы завершены.
+    //Первое исключение из func пробрасывается после завершения остальных вызовов
+    template <typename Func>
+    void ParallelFor(size_t count, const Func& func);
+
+    //Сортировка кусков на пуле и попарное слияние
+    template <typename RandomIt, typename Compare>
+    void ParallelSort(RandomIt first, RandomIt last, Compare comp);
+
+private:
+    struct TaskGroup {
+        void (*invoke)(const void* func, size_t index);
+        const void* func;
+        std::atomic<size_t> pending = 0;
+        //Защищает error и завершение задач: ожидающий поток засыпает на done, когда выполнять больше нечего
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    struct Task {
+        TaskGroup* group;
+        size_t first;
+        size_t last;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_; //По очереди на фоновый поток, последняя - для остальных потоков
+    std::vector<std::thread> workers_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> queued_ = 0;
+    bool stopping_ = false;
+
+    void Run(TaskGroup& group, size_t count);
+    //Выполняет одну задачу из своей или чужой очереди, возвращает false, если задач нет
+    bool TryRunTask(size_t home_queue);
+    void RunTask(const Task& task);
+    void WorkerLoop(size_t worker_index);
+    size_t GetHomeQueue() const;
+};
+
+template <typename Func>
+void ThreadPool::ParallelFor(size_t count, const Func& func) {
+    if (count == 0) {
+        return;
+    }
+    TaskGroup group;
+    group.invoke = [](const void* func, size_t index) {
+        (*static_cast<const Func*>(func))(index);
+    };
+    group.func = &func;
+    Run(group, count);
+    if (group.error) {
+        std::rethrow_exception(group.error);
+    }
+}
+
+template <typename RandomIt, typename Compare>
+void ThreadPool::ParallelSort(RandomIt first, RandomIt last, Compare comp) {
+    const size_t size = std::distance(first, last);
+    const size_t min_chunk_size = 1 << 14;
+    size_t chunk_count = std::min<size_t>(GetConcurrency(), std::max<size_t>(size / min_chunk_size, 1));
+    if (chunk_count <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+    std::vector<size_t> bounds(chunk_count + 1);
+    for (size_t chunk = 0; chunk <= chunk_count; ++chunk) {
+        bounds[chunk] = size * chunk / chunk_count;
+    }
+    ParallelFor(chunk_count, [&](size_t chunk) {
+        std::sort(first + bounds[chunk], first + bounds[chunk + 1], comp);
+    });
+    for (size_t step = 1; step < chunk_count; step *= 2) {
+        ParallelFor((chunk_count + 2 * step - 1) / (2 * step), [&](size_t pair) {
+            const size_t left = 2 * step * pair;
+            const size_t middle = std::min(left + step, chunk_count);
+            const size_t right = std::min(left + 2 * step, chunk_count);
+            std::inplace_merge(first + bounds[left], first + bounds[middle], first + bounds[right], comp);
+        });
+    }
+}
@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+#include "../search_server.h"
+#include "../thread_pool.h"
+
+using namespace std;
+
+//Набор замеров всех операций SearchServer на корпусах с частотами слов по закону Ципфа.
+//Для каждой пары (размер корпуса, показатель Ципфа) измеряется задержка каждого вызова в наносекундах,
+//в stderr выводится таблица, в stdout или файл --output - JSON для сравнения версий.
+//  benchmark [--sizes N,N] [--skews S,S] [--vocabulary N] [--document-words N] [--query-words N] [--queries N]
+//            [--repeats N] [--removals N] [--stop-words N] [--threads N] [--seed N] [--output PATH]
+namespace {
+
+struct Options {
+    vector<int> corpus_sizes = {10000, 100000};
+    vector<double> zipf_skews = {0.8, 1.2};
+    int vocabulary_size = 50000;
+    int document_word_count = 50;
+    int query_word_count = 3;
+    int query_count = 1000;
+    int repeat_count = 10; //Для операций над всем индексом: ProcessQueries, RemoveDuplicates
+    int removal_count = 1000; //На каждую политику RemoveDocument
+    int stop_word_count = 10; //Самые частые слова словаря
+    int thread_count = 0; //0 - параллельные перегрузки идут через std::execution::par, иначе через ThreadPool
+    unsigned seed = 42;
+    string output_path;
+};
+
+struct Corpus {
+    vector<string> vocabulary; //По убыванию частоты
+    string stop_words;
+    vector<string> documents;
+    vector<string> queries;
+};
+
+struct Result {
+    int corpus_size;
+    double zipf_skew;
+    string operation;
+    vector<int64_t> latencies_ns;
+};
+
+//Не даёт компилятору выбросить замеряемые вызовы
+size_t checksum = 0;
+
+template <typename Value>
+vector<Value> ParseList(const string& text) {
+    vector<Value> values;
+    istringstream input(text);
+    for (string item; getline(input, item, ',');) {
+        istringstream item_input(item);
+        Value value;
+        if (!(item_input >> value)) {
+            throw invalid_argument("Invalid list: "s + text);
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+vector<string> GenerateVocabulary(mt19937& generator, int size) {
+    uniform_int_distribution<int> length_distribution(3, 10);
+    uniform_int_distribution<int> letter_distribution('a', 'z');
+    set<string> unique_words;
+    vector<string> vocabulary;
+    while (static_cast<int>(vocabulary.size()) < size) {
+        string word(length_distribution(generator), ' ');
+        for (char& c : word) {
+            c = static_cast<char>(letter_distribution(generator));
+        }
+        if (unique_words.insert(word).second) {
+            vocabulary.push_back(move(word));
+        }
+    }
+    return vocabulary;
+}
+
+Corpus GenerateCorpus(const Options& options, int corpus_size, double zipf_skew) {
+    mt19937 generator(options.seed);
+    Corpus corpus;
+    corpus.vocabulary = GenerateVocabulary(generator, options.vocabulary_size);
+    for (int i = 0; i < min(options.stop_word_count, options.vocabulary_size); ++i) {
+        corpus.stop_words += corpus.vocabulary[i] + " "s;
+    }
+    vector<double> weights(corpus.vocabulary.size());
+    for (size_t rank = 0; rank < weights.size(); ++rank) {
+        weights[rank] = 1.0 / pow(rank + 1.0, zipf_skew);
+    }
+    discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    const auto generate_text = [&](int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            text += corpus.vocabulary[word_distribution(generator)] + " "s;
+        }
+        return text;
+    };
+    corpus.documents.reserve(corpus_size);
+    for (int i = 0; i < corpus_size; ++i) {
+        corpus.documents.push_back(generate_text(options.document_word_count));
+    }
+    //Каждый десятый запрос с минус-словом
+    bernoulli_distribution minus_distribution(0.1);
+    for (int i = 0; i < options.query_count; ++i) {
+        string query = generate_text(options.query_word_count);
+        if (minus_distribution(generator)) {
+            query += "-"s + corpus.vocabulary[word_distribution(generator)];
+        }
+        corpus.queries.push_back(move(query));
+    }
+    return corpus;
+}
+
+template <typename Func>
+int64_t Measure(Func func) {
+    const auto start = chrono::steady_clock::now();
+    func();
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+//Ближайший ранг: наименьшая задержка, не меньше которой доля fraction всех замеров
+int64_t Percentile(const vector<int64_t>& sorted_latencies, double fraction) {
+    const size_t rank = static_cast<size_t>(ceil(fraction * sorted_latencies.size()));
+    return sorted_latencies[min(sorted_latencies.size(), max<size_t>(rank, 1)) - 1];
+}
+
+vector<Result> RunCorpus(const Options& options, ThreadPool* thread_pool, int corpus_size, double zipf_skew) {
+    const Corpus corpus = GenerateCorpus(options, corpus_size, zipf_skew);
+    vector<Result> results;
+    const auto add_result = [&](string operation) -> vector<int64_t>& {
+        results.push_back({corpus_size, zipf_skew, move(operation), {}});
+        return results.back().latencies_ns;
+    };
+    mt19937 generator(options.seed + 1);
+
+    SearchServer server(corpus.stop_words);
+    server.SetThreadPool(thread_pool);
+    {
+        vector<int64_t>& latencies = add_result("AddDocument"s);
+        for (int id = 0; id < corpus_size; ++id) {
+            const DocumentStatus status = id % 10 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+            latencies.push_back(Measure([&] {
+                server.AddDocument(id, corpus.documents[id], status, {id % 10, id % 7});
+            }));
+        }
+    }
+
+    const auto benchmark_queries = [&](const string& operation, const auto& find) {
+        vector<int64_t>& latencies = add_result(operation);
+        for (const string& query : corpus.queries) {
+            latencies.push_back(Measure([&] {
+                checksum += find(query).size();
+            }));
+        }
+    };
+    const auto predicate = [](int document_id, DocumentStatus, int rating) {
+        return document_id % 2 == 0 && rating > 2;
+    };
+    benchmark_queries("FindTopDocuments(seq)"s, [&](const string& query) {
+        return server.FindTopDocuments(execution::seq, query);
+    });
+    benchmark_queries("FindTopDocuments(par)"s, [&](const string& query) {
+        return server.FindTopDocuments(execution::par, query);
+    });
+    benchmark_queries("FindTopDocuments(seq, predicate)"s, [&](const string& query) {
+        return server.FindTopDocuments(execution::seq, query, predicate);
+    });
+    benchmark_queries("FindTopDocuments(par, predicate)"s, [&](const string& query) {
+        return server.FindTopDocuments(execution::par, query, predicate);
+    });
+
+    uniform_int_distribution<int> id_distribution(0, corpus_size - 1);
+    benchmark_queries("MatchDocument(seq)"s, [&](const string& query) {
+        return get<0>(server.MatchDocument(execution::seq, query, id_distribution(generator)));
+    });
+    benchmark_queries("MatchDocument(par)"s, [&](const string& query) {
+        return get<0>(server.MatchDocument(execution::par, query, id_distribution(generator)));
+    });
+
+    {
+        vector<int64_t>& latencies = add_result("ProcessQueries"s);
+        for (int i = 0; i < options.repeat_count; ++i) {
+            latencies.push_back(Measure([&] {
+                checksum += ProcessQueries(server, corpus.queries).size();
+            }));
+        }
+    }
+    {
+        vector<int64_t>& latencies = add_result("ProcessQueriesJoined"s);
+        for (int i = 0; i < options.repeat_count; ++i) {
+            latencies.push_back(Measure([&] {
+                checksum += ProcessQueriesJoined(server, corpus.queries).size();
+            }));
+        }
+    }
+
+    {
+        //Перед каждым замером добавляются повторы 5% документов, RemoveDuplicates их удаляет
+        vector<int64_t>& latencies = add_result("RemoveDuplicates"s);
+        int next_id = corpus_size;
+        streambuf* const cout_buffer = cout.rdbuf();
+        for (int i = 0; i < options.repeat_count; ++i) {
+            for (int j = 0; j < max(1, corpus_size / 20); ++j) {
+                server.AddDocument(next_id++, corpus.documents[id_distribution(generator)], DocumentStatus::ACTUAL, {1});
+            }
+            cout.rdbuf(nullptr);
+            latencies.push_back(Measure([&] {
+                RemoveDuplicates(server);
+            }));
+            cout.rdbuf(cout_buffer);
+            cout.clear();
+        }
+    }
+
+    {
+        vector<int> ids(server.begin(), server.end());
+        shuffle(ids.begin(), ids.end(), generator);
+        const size_t removal_count = min<size_t>(options.removal_count, ids.size() / 2);
+        vector<int64_t>& seq_latencies = add_result("RemoveDocument(seq)"s);
+        for (size_t i = 0; i < removal_count; ++i) {
+            seq_latencies.push_back(Measure([&] {
+                server.RemoveDocument(execution::seq, ids[i]);
+            }));
+        }
+        vector<int64_t>& par_latencies = add_result("RemoveDocument(par)"s);
+        for (size_t i = removal_count; i < 2 * removal_count; ++i) {
+            par_latencies.push_back(Measure([&] {
+                server.RemoveDocument(execution::par, ids[i]);
+            }));
+        }
+    }
+    return results;
+}
+
+string EscapeJson(const string& text) {
+    string escaped;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+//Порядок полей и записей фиксирован, поэтому отчёты двух версий сравниваются обычным diff
+void WriteJson(ostream& out, const Options& options, const vector<Result>& results) {
+    out << "{\n"s;
+    out << "  \"config\": {\"vocabulary\": "s << options.vocabulary_size << ", \"document_words\": "s << options.document_word_count
+        << ", \"query_words\": "s << options.query_word_count << ", \"queries\": "s << options.query_count
+        << ", \"repeats\": "s << options.repeat_count << ", \"removals\": "s << options.removal_count
+        << ", \"stop_words\": "s << options.stop_word_count << ", \"threads\": "s << options.thread_count
+        << ", \"seed\": "s << options.seed << "},\n"s;
+    out << "  \"results\": [\n"s;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        vector<int64_t> sorted_latencies = result.latencies_ns;
+        sort(sorted_latencies.begin(), sorted_latencies.end());
+        out << "    {\"corpus_size\": "s << result.corpus_size << ", \"zipf_skew\": "s << result.zipf_skew
+            << ", \"operation\": \""s << EscapeJson(result.operation) << "\", \"samples\": "s << sorted_latencies.size();
+        if (!sorted_latencies.empty()) {
+            const int64_t total = accumulate(sorted_latencies.begin(), sorted_latencies.end(), int64_t{0});
+            out << ", \"mean_ns\": "s << total / static_cast<int64_t>(sorted_latencies.size())
+                << ", \"p50_ns\": "s << Percentile(sorted_latencies, 0.50) << ", \"p99_ns\": "s << Percentile(sorted_latencies, 0.99)
+                << ", \"p999_ns\": "s << Percentile(sorted_latencies, 0.999) << ", \"max_ns\": "s << sorted_latencies.back();
+        }
+        out << (i + 1 < results.size() ? "},\n"s : "}\n"s);
+    }
+    out << "  ]\n}\n"s;
+}
+
+void PrintTable(const vector<Result>& results, size_t first) {
+    cerr << left << setw(34) << "operation"s << right << setw(9) << "samples"s << setw(14) << "p50, us"s
+         << setw(14) << "p99, us"s << setw(14) << "p999, us"s << endl;
+    cerr << fixed << setprecision(1);
+    for (size_t i = first; i < results.size(); ++i) {
+        vector<int64_t> sorted_latencies = results[i].latencies_ns;
+        if (sorted_latencies.empty()) {
+            continue;
+        }
+        sort(sorted_latencies.begin(), sorted_latencies.end());
+        cerr << left << setw(34) << results[i].operation << right << setw(9) << sorted_latencies.size()
+             << setw(14) << Percentile(sorted_latencies, 0.50) / 1000.0 << setw(14) << Percentile(sorted_latencies, 0.99) / 1000.0
+             << setw(14) << Percentile(sorted_latencies, 0.999) / 1000.0 << endl;
+    }
+    cerr << defaultfloat;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const string option = argv[i];
+            const string value = argv[i + 1];
+            if (option == "--sizes"s) {
+                options.corpus_sizes = ParseList<int>(value);
+            } else if (option == "--skews"s) {
+                options.zipf_skews = ParseList<double>(value);
+            } else if (option == "--vocabulary"s) {
+                options.vocabulary_size = stoi(value);
+            } else if (option == "--document-words"s) {
+                options.document_word_count = stoi(value);
+            } else if (option == "--query-words"s) {
+                options.query_word_count = stoi(value);
+            } else if (option == "--queries"s) {
+                options.query_count = stoi(value);
+            } else if (option == "--repeats"s) {
+                options.repeat_count = stoi(value);
+            } else if (option == "--removals"s) {
+                options.removal_count = stoi(value);
+            } else if (option == "--stop-words"s) {
+                options.stop_word_count = stoi(value);
+            } else if (option == "--threads"s) {
+                options.thread_count = stoi(value);
+            } else if (option == "--seed"s) {
+                options.seed = static_cast<unsigned>(stoul(value));
+            } else if (option == "--output"s) {
+                options.output_path = value;
+            } else {
+                cerr << "Unknown option "s << option << endl;
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    if (options.vocabulary_size <= 0 || options.document_word_count <= 0 || options.query_count <= 0
+        || any_of(options.corpus_sizes.begin(), options.corpus_sizes.end(), [](int size) { return size <= 0; })) {
+        cerr << "Sizes and counts must be positive"s << endl;
+        return 1;
+    }
+
+    unique_ptr<ThreadPool> thread_pool;
+    if (options.thread_count > 0) {
+        thread_pool = make_unique<ThreadPool>(options.thread_count);
+    }
+    vector<Result> results;
+    for (const int corpus_size : options.corpus_sizes) {
+        for (const double zipf_skew : options.zipf_skews) {
+            cerr << "corpus size "s << corpus_size << ", zipf skew "s << zipf_skew << endl;
+            const size_t first = results.size();
+            for (Result& result : RunCorpus(options, thread_pool.get(), corpus_size, zipf_skew)) {
+                results.push_back(move(result));
+            }
+            PrintTable(results, first);
+        }
+    }
+    cerr << "checksum: "s << checksum << endl;
+
+    if (options.output_path.empty()) {
+        WriteJson(cout, options, results);
+    } else {
+        ofstream out(options.output_path);
+        WriteJson(out, options, results);
+        if (!out) {
+            cerr << "Cannot write "s << options.output_path << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
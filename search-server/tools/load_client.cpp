@@ -0,0 +1,185 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//Нагрузочный клиент для search_daemon: каждое соединение в своём потоке шлёт FIND и ждёт ответа,
+//по задержкам всех запросов считаются QPS, p50 и p99. Запросы строятся из словаря search_daemon --generate.
+//  load_client [--host IP] [--port N | --unix PATH] [--connections N] [--requests N] [--words N] [--top N]
+namespace {
+
+struct Options {
+    string host = "127.0.0.1"s;
+    int port = 7070;
+    string unix_path;
+    int connection_count = 8;
+    int request_count = 10000; //На одно соединение
+    int query_word_count = 3;
+    int top_count = 5;
+};
+
+int Connect(const Options& options) {
+    int fd = -1;
+    if (!options.unix_path.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, options.unix_path.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            return fd;
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(options.port));
+        inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            const int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            return fd;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    throw runtime_error("Cannot connect: "s + strerror(errno));
+}
+
+struct ConnectionResult {
+    vector<int64_t> latencies_ns;
+    int error_count = 0;
+};
+
+void RunConnection(const Options& options, int seed, ConnectionResult& result) {
+    const int fd = Connect(options);
+    mt19937 generator(seed);
+    vector<double> weights;
+    for (int i = 0; i < 10000; ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    string request;
+    string response;
+    char buffer[16 * 1024];
+    result.latencies_ns.reserve(options.request_count);
+    for (int i = 0; i < options.request_count; ++i) {
+        request = "FIND "s + to_string(options.top_count);
+        for (int j = 0; j < options.query_word_count; ++j) {
+            request += " w"s + to_string(word_distribution(generator));
+        }
+        request.push_back('\n');
+        const auto start = chrono::steady_clock::now();
+        for (size_t sent = 0; sent < request.size();) {
+            const ssize_t size = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (size <= 0) {
+                close(fd);
+                throw runtime_error("Connection lost"s);
+            }
+            sent += size;
+        }
+        response.clear();
+        while (response.empty() || response.back() != '\n') {
+            const ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+            if (size <= 0) {
+                close(fd);
+                throw runtime_error("Connection lost"s);
+            }
+            response.append(buffer, size);
+        }
+        const auto finish = chrono::steady_clock::now();
+        result.latencies_ns.push_back(chrono::duration_cast<chrono::nanoseconds>(finish - start).count());
+        if (response.compare(0, 3, "OK "s) != 0) {
+            ++result.error_count;
+        }
+    }
+    close(fd);
+}
+
+double Percentile(const vector<int64_t>& sorted_latencies, double fraction) {
+    const size_t index = min(sorted_latencies.size() - 1, static_cast<size_t>(fraction * sorted_latencies.size()));
+    return sorted_latencies[index] / 1000.0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string option = argv[i];
+        const string value = argv[i + 1];
+        if (option == "--host"s) {
+            options.host = value;
+        } else if (option == "--port"s) {
+            options.port = stoi(value);
+        } else if (option == "--unix"s) {
+            options.unix_path = value;
+        } else if (option == "--connections"s) {
+            options.connection_count = stoi(value);
+        } else if (option == "--requests"s) {
+            options.request_count = stoi(value);
+        } else if (option == "--words"s) {
+            options.query_word_count = stoi(value);
+        } else if (option == "--top"s) {
+            options.top_count = stoi(value);
+        } else {
+            cerr << "Unknown option "s << option << endl;
+            return 1;
+        }
+    }
+    if (options.connection_count <= 0 || options.request_count <= 0) {
+        cerr << "Connection and request counts must be positive"s << endl;
+        return 1;
+    }
+
+    vector<ConnectionResult> results(options.connection_count);
+    vector<string> errors(options.connection_count);
+    vector<thread> threads;
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < options.connection_count; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                RunConnection(options, i + 1, results[i]);
+            } catch (const exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<int64_t> latencies;
+    int error_count = 0;
+    for (int i = 0; i < options.connection_count; ++i) {
+        if (!errors[i].empty()) {
+            cerr << "Connection "s << i << ": "s << errors[i] << endl;
+        }
+        latencies.insert(latencies.end(), results[i].latencies_ns.begin(), results[i].latencies_ns.end());
+        error_count += results[i].error_count;
+    }
+    if (latencies.empty()) {
+        return 1;
+    }
+    sort(latencies.begin(), latencies.end());
+    cout << "requests: "s << latencies.size() << ", errors: "s << error_count << endl;
+    cout << "QPS: "s << static_cast<int64_t>(latencies.size() / seconds) << endl;
+    cout << "p50: "s << Percentile(latencies, 0.50) << " us, p99: "s << Percentile(latencies, 0.99)
+         << " us, max: "s << latencies.back() / 1000.0 << " us"s << endl;
+    return 0;
+}
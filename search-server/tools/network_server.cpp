@@ -0,0 +1,330 @@
+#include "network_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+const int MAX_EVENTS = 256;
+const size_t READ_CHUNK_SIZE = 16 * 1024;
+//Соединения взводятся однократно: после события сокет молчит, пока его не взведут снова
+const uint32_t WAIT_REQUEST = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+const uint32_t WAIT_WRITE = EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT;
+//Пауза приёма, если дескрипторов нет, а запасной занять не удалось
+const auto ACCEPT_BACKOFF = std::chrono::milliseconds(10);
+
+int OpenSpareFd() {
+    return open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+NetworkServer::NetworkServer(RequestHandler& handler, int worker_count)
+    : handler_(handler) {
+    using std::literals::string_literals::operator""s;
+    if (worker_count <= 0) {
+        throw std::invalid_argument("Worker count must be positive"s);
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        ThrowSystemError("epoll_create1");
+    }
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) {
+        close(epoll_fd_);
+        ThrowSystemError("eventfd");
+    }
+    Watch(event_fd_, EPOLLIN, true);
+    spare_fd_ = OpenSpareFd();
+    for (int i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] {
+            WorkerLoop();
+        });
+    }
+}
+
+NetworkServer::~NetworkServer() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    has_jobs_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    for (const auto& [fd, connection] : connections_) {
+        close(fd);
+    }
+    for (const int fd : listen_fds_) {
+        close(fd);
+    }
+    if (spare_fd_ >= 0) {
+        close(spare_fd_);
+    }
+    close(event_fd_);
+    close(epoll_fd_);
+}
+
+void NetworkServer::ListenTcp(uint16_t port) {
+    const int fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket");
+    }
+    const int on = 1;
+    const int off = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        ThrowSystemError("bind");
+    }
+    AddListener(fd);
+}
+
+void NetworkServer::ListenUnix(const std::string& path) {
+    using std::literals::string_literals::operator""s;
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Unix socket path is too long"s);
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket");
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        ThrowSystemError("bind");
+    }
+    AddListener(fd);
+}
+
+void NetworkServer::Run() {
+    epoll_event events[MAX_EVENTS];
+    while (!stopping_) {
+        const int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == event_fd_) {
+                uint64_t counter;
+                [[maybe_unused]] const ssize_t size = read(event_fd_, &counter, sizeof(counter));
+                CompleteJobs();
+                continue;
+            }
+            if (std::find(listen_fds_.begin(), listen_fds_.end(), fd) != listen_fds_.end()) {
+                Accept(fd);
+                continue;
+            }
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            if (connection.output_pos == connection.output.size()) {
+                Read(connection);
+            } else if (Write(connection)) {
+                Resume(connection);
+            } else {
+                Watch(fd, WAIT_WRITE, false);
+            }
+        }
+    }
+}
+
+void NetworkServer::Stop() {
+    stopping_ = true;
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t size = write(event_fd_, &one, sizeof(one));
+}
+
+void NetworkServer::AddListener(int fd) {
+    listen_fds_.push_back(fd);
+    Watch(fd, EPOLLIN, true);
+}
+
+void NetworkServer::Watch(int fd, uint32_t events, bool add) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0) {
+        ThrowSystemError("epoll_ctl");
+    }
+}
+
+void NetworkServer::Accept(int listen_fd) {
+    using std::literals::string_view_literals::operator""sv;
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            const int error = errno;
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return;
+            }
+            if (error == EINTR || error == ECONNABORTED) {
+                continue;
+            }
+            if (error == EMFILE || error == ENFILE) {
+                if (spare_fd_ >= 0) {
+                    std::cerr << "accept: "sv << std::strerror(error) << ", dropping connection"sv << std::endl;
+                    close(spare_fd_);
+                    const int dropped_fd = accept(listen_fd, nullptr, nullptr);
+                    if (dropped_fd >= 0) {
+                        close(dropped_fd);
+                    }
+                    spare_fd_ = OpenSpareFd();
+                } else {
+                    std::cerr << "accept: "sv << std::strerror(error) << ", pausing"sv << std::endl;
+                    spare_fd_ = OpenSpareFd();
+                    std::this_thread::sleep_for(ACCEPT_BACKOFF);
+                }
+                return;
+            }
+            //Остальные ошибки относятся к одному соединению
+            std::cerr << "accept: "sv << std::strerror(error) << std::endl;
+            return;
+        }
+        const int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connections_[fd] = std::move(connection);
+        Watch(fd, WAIT_REQUEST, true);
+    }
+}
+
+void NetworkServer::Read(Connection& connection) {
+    while (connection.input.size() <= MAX_REQUEST_SIZE) {
+        const size_t size = connection.input.size();
+        connection.input.resize(size + READ_CHUNK_SIZE);
+        const ssize_t read_size = read(connection.fd, connection.input.data() + size, READ_CHUNK_SIZE);
+        connection.input.resize(size + std::max<ssize_t>(read_size, 0));
+        if (read_size > 0) {
+            continue;
+        }
+        if (read_size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            connection.peer_closed = true;
+        }
+        break;
+    }
+    Resume(connection);
+}
+
+void NetworkServer::Resume(Connection& connection) {
+    const size_t line_end = connection.input.find('\n');
+    if (line_end == std::string::npos) {
+        if (connection.peer_closed || connection.input.size() > MAX_REQUEST_SIZE) {
+            Close(connection);
+        } else {
+            Watch(connection.fd, WAIT_REQUEST, false);
+        }
+        return;
+    }
+    //Сокет не взводится, пока запрос выполняется: входной буфер не меняется, и на него можно ссылаться из пула
+    connection.request_size = line_end + 1;
+    {
+        std::lock_guard lock(mutex_);
+        jobs_.push_back(&connection);
+    }
+    has_jobs_.notify_one();
+}
+
+void NetworkServer::CompleteJobs() {
+    std::vector<Connection*> completed;
+    {
+        std::lock_guard lock(mutex_);
+        completed.swap(completed_);
+    }
+    for (Connection* connection : completed) {
+        connection->input.erase(0, connection->request_size);
+        if (Write(*connection)) {
+            Resume(*connection);
+        } else {
+            Watch(connection->fd, WAIT_WRITE, false);
+        }
+    }
+}
+
+bool NetworkServer::Write(Connection& connection) {
+    while (connection.output_pos < connection.output.size()) {
+        const ssize_t written = send(connection.fd, connection.output.data() + connection.output_pos,
+                                     connection.output.size() - connection.output_pos, MSG_NOSIGNAL);
+        if (written > 0) {
+            connection.output_pos += written;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return false;
+        } else if (errno != EINTR) {
+            //Ответ отправить некому, оставшиеся запросы отбрасываются
+            connection.peer_closed = true;
+            connection.input.clear();
+            return true;
+        }
+    }
+    return true;
+}
+
+void NetworkServer::Close(Connection& connection) {
+    const int fd = connection.fd;
+    close(fd);
+    connections_.erase(fd);
+}
+
+void NetworkServer::WorkerLoop() {
+    while (true) {
+        Connection* connection = nullptr;
+        {
+            std::unique_lock lock(mutex_);
+            has_jobs_.wait(lock, [this] {
+                return stopping_ || !jobs_.empty();
+            });
+            if (jobs_.empty()) {
+                return;
+            }
+            connection = jobs_.front();
+            jobs_.pop_front();
+        }
+        const std::string_view request(connection->input.data(), connection->request_size - 1);
+        handler_.Handle(request, connection->output);
+        connection->output.push_back('\n');
+        connection->output_pos = 0;
+        {
+            std::lock_guard lock(mutex_);
+            completed_.push_back(connection);
+        }
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t size = write(event_fd_, &one, sizeof(one));
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../request_handler.h"
+
+//Сетевой фронтенд поискового сервера (только Linux): один поток с epoll принимает соединения и читает запросы,
+//запросы выполняются фиксированным пулом рабочих потоков. Запрос - строка до '\n', см. RequestHandler.
+//В соединении выполняется не больше одного запроса за раз, ответы идут в порядке запросов.
+//Буферы соединения переиспользуются, рабочий поток получает запрос как string_view на входной буфер
+class NetworkServer {
+public:
+    //Запрос длиннее ограничения закрывает соединение
+    static constexpr size_t MAX_REQUEST_SIZE = 1 << 20;
+
+    NetworkServer(RequestHandler& handler, int worker_count);
+    ~NetworkServer();
+    NetworkServer(const NetworkServer&) = delete;
+    NetworkServer& operator=(const NetworkServer&) = delete;
+
+    void ListenTcp(uint16_t port);
+    void ListenUnix(const std::string& path);
+
+    //Обслуживает соединения до вызова Stop
+    void Run();
+    //Можно вызывать из другого потока и из обработчика сигнала
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        size_t request_size = 0; //Длина выполняемого запроса вместе с '\n'
+        std::string output;
+        size_t output_pos = 0;
+        bool peer_closed = false;
+    };
+
+    RequestHandler& handler_;
+    int epoll_fd_ = -1;
+    int event_fd_ = -1;
+    //Запасной дескриптор: при исчерпании дескрипторов он освобождается, чтобы принять и сразу закрыть
+    //соединение. Иначе соединение остаётся в очереди и epoll без конца будит цикл
+    int spare_fd_ = -1;
+    std::vector<int> listen_fds_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::atomic<bool> stopping_ = false;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable has_jobs_;
+    std::deque<Connection*> jobs_;
+    std::vector<Connection*> completed_;
+
+    void AddListener(int fd);
+    void Watch(int fd, uint32_t events, bool add);
+    void Accept(int listen_fd);
+    void Read(Connection& connection);
+    //Отправляет в пул следующий полный запрос из входного буфера или снова ждёт данных
+    void Resume(Connection& connection);
+    void CompleteJobs();
+    //Возвращает false, если ответ не ушёл целиком и нужно дождаться EPOLLOUT
+    bool Write(Connection& connection);
+    void Close(Connection& connection);
+    void WorkerLoop();
+};
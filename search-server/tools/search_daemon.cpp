@@ -0,0 +1,119 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "network_server.h"
+#include "../request_handler.h"
+#include "../search_server.h"
+
+using namespace std;
+
+//Сервер поиска по сети. Индекс загружается из снимка или генерируется, дальше меняется запросами ADD и REMOVE.
+//  search_daemon [--port N] [--unix PATH] [--workers N] [--snapshot PATH | --generate N] [--stop-words TEXT]
+namespace {
+
+struct Options {
+    int port = -1;
+    string unix_path;
+    int worker_count = max(1u, thread::hardware_concurrency());
+    string snapshot_path;
+    int generate_count = 0;
+    string stop_words = "and in on"s;
+};
+
+NetworkServer* running_server = nullptr;
+
+void HandleSignal(int) {
+    if (running_server != nullptr) {
+        running_server->Stop();
+    }
+}
+
+//Документы из слов w0..w9999 с распределением Ципфа, load_client строит запросы из того же словаря
+void GenerateDocuments(SearchServer& server, int document_count) {
+    mt19937 generator(1);
+    vector<double> weights;
+    for (int i = 0; i < 10000; ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    discrete_distribution<int> word_distribution(weights.begin(), weights.end());
+    vector<string> texts(document_count);
+    vector<SearchServer::NewDocument> documents;
+    for (int id = 0; id < document_count; ++id) {
+        for (int i = 0; i < 50; ++i) {
+            texts[id] += "w"s + to_string(word_distribution(generator)) + " "s;
+        }
+        documents.push_back({id, texts[id], DocumentStatus::ACTUAL, {id % 10}});
+    }
+    server.AddDocuments(documents);
+}
+
+void Serve(SearchServer& server, const Options& options) {
+    cerr << "Documents: "s << server.GetDocumentCount() << endl;
+    MetricsRegistry metrics;
+    server.SetMetrics(&metrics);
+    RequestHandler handler(server, &metrics);
+    NetworkServer network_server(handler, options.worker_count);
+    if (options.port >= 0) {
+        network_server.ListenTcp(static_cast<uint16_t>(options.port));
+        cerr << "Listening on port "s << options.port << endl;
+    }
+    if (!options.unix_path.empty()) {
+        network_server.ListenUnix(options.unix_path);
+        cerr << "Listening on "s << options.unix_path << endl;
+    }
+    running_server = &network_server;
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+    network_server.Run();
+    running_server = nullptr;
+    server.SetMetrics(nullptr);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string option = argv[i];
+        const string value = argv[i + 1];
+        if (option == "--port"s) {
+            options.port = stoi(value);
+        } else if (option == "--unix"s) {
+            options.unix_path = value;
+        } else if (option == "--workers"s) {
+            options.worker_count = stoi(value);
+        } else if (option == "--snapshot"s) {
+            options.snapshot_path = value;
+        } else if (option == "--generate"s) {
+            options.generate_count = stoi(value);
+        } else if (option == "--stop-words"s) {
+            options.stop_words = value;
+        } else {
+            cerr << "Unknown option "s << option << endl;
+            return 1;
+        }
+    }
+    if (options.port < 0 && options.unix_path.empty()) {
+        options.port = 7070;
+    }
+    try {
+        if (!options.snapshot_path.empty()) {
+            SearchServer server = SearchServer::LoadSnapshot(options.snapshot_path);
+            Serve(server, options);
+        } else {
+            SearchServer server(options.stop_words);
+            GenerateDocuments(server, options.generate_count);
+            Serve(server, options);
+        }
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
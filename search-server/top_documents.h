@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "document.h"
+
+const double COMPARISSON_PRECISION = 1e-6;
+
+//Порядок выдачи: по убыванию релевантности, при равной (с точностью COMPARISSON_PRECISION)
+//релевантности - по убыванию рейтинга, затем по возрастанию id
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < COMPARISSON_PRECISION) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+//Ограниченная куча, хранящая top_count лучших документов. На вершине - худший из них
+class TopDocuments {
+public:
+    explicit TopDocuments(int top_count = 0)
+        : top_count_(std::max(top_count, 0)) {
+    }
+
+    bool IsFull() const {
+        return static_cast<int>(heap_.size()) >= top_count_;
+    }
+
+    size_t GetSize() const {
+        return heap_.size();
+    }
+
+    //Худший из отобранных документов, только для заполненной кучи
+    const Document& Worst() const {
+        return heap_.front();
+    }
+
+    void Push(const Document& document) {
+        if (!IsFull()) {
+            if (heap_.empty()) {
+                //Куча растёт одним выделением, а не удвоениями. Для большого top_count резерв ограничен
+                heap_.reserve(std::min(top_count_, MAX_RESERVED_COUNT));
+            }
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        } else if (top_count_ > 0 && IsMoreRelevant(document, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    void Merge(const TopDocuments& other) {
+        for (const Document& document : other.heap_) {
+            Push(document);
+        }
+    }
+
+    //Документы от лучшего к худшему, куча после вызова пуста
+    std::vector<Document> ExtractSorted() {
+        std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        std::vector<Document> result = std::move(heap_);
+        heap_.clear();
+        return result;
+    }
+
+private:
+    static constexpr int MAX_RESERVED_COUNT = 1024;
+
+    int top_count_;
+    std::vector<Document> heap_;
+};